@@ -38,6 +38,12 @@ android {
     buildFeatures {
         compose = true
     }
+    // The DCQL engine of the matchers, see DcqlEngine.kt
+    externalNativeBuild {
+        cmake {
+            path = file("src/main/cpp/CMakeLists.txt")
+        }
+    }
 }
 
 dependencies {
@@ -0,0 +1,108 @@
+#include <jni.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dcql_engine.h"
+
+// JNI binding of matcher/dcql_engine.h for DcqlEngine.kt. Handles go to Kotlin as jlongs, 0 for
+// NULL. Strings cross as UTF-8 byte arrays, modified UTF-8 of the JNI string functions differs
+// from the json for supplementary characters.
+
+static char* CopyBytes(JNIEnv* env, jbyteArray bytes) {
+    jsize len = (*env)->GetArrayLength(env, bytes);
+    char* copy = malloc(len + 1);
+    (*env)->GetByteArrayRegion(env, bytes, 0, len, (jbyte*)copy);
+    copy[len] = '\0';
+    return copy;
+}
+
+static jbyteArray NewBytes(JNIEnv* env, const char* value) {
+    if (value == NULL) {
+        return NULL;
+    }
+    jsize len = (jsize)strlen(value);
+    jbyteArray bytes = (*env)->NewByteArray(env, len);
+    (*env)->SetByteArrayRegion(env, bytes, 0, len, (const jbyte*)value);
+    return bytes;
+}
+
+#define MATCH(handle) ((const DcqlMatch*)(intptr_t)(handle))
+
+JNIEXPORT jint JNICALL
+Java_com_credman_cmwallet_openid4vp_DcqlEngine_nativeApiVersion(JNIEnv* env, jobject thiz) {
+    (void)env; (void)thiz;
+    return DcqlEngineApiVersion();
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_credman_cmwallet_openid4vp_DcqlEngine_nativeStoreParse(JNIEnv* env, jobject thiz, jbyteArray registry_json) {
+    (void)thiz;
+    char* json = CopyBytes(env, registry_json);
+    DcqlStore* store = DcqlStoreParse(json);
+    free(json);
+    return (jlong)(intptr_t)store;
+}
+
+JNIEXPORT void JNICALL
+Java_com_credman_cmwallet_openid4vp_DcqlEngine_nativeStoreFree(JNIEnv* env, jobject thiz, jlong store) {
+    (void)env; (void)thiz;
+    DcqlStoreFree((DcqlStore*)(intptr_t)store);
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_credman_cmwallet_openid4vp_DcqlEngine_nativeMatchQuery(JNIEnv* env, jobject thiz, jlong store, jbyteArray dcql_query_json) {
+    (void)thiz;
+    char* json = CopyBytes(env, dcql_query_json);
+    DcqlMatch* match = DcqlMatchQuery((const DcqlStore*)(intptr_t)store, json);
+    free(json);
+    return (jlong)(intptr_t)match;
+}
+
+JNIEXPORT void JNICALL
+Java_com_credman_cmwallet_openid4vp_DcqlEngine_nativeMatchFree(JNIEnv* env, jobject thiz, jlong match) {
+    (void)env; (void)thiz;
+    DcqlMatchFree((DcqlMatch*)(intptr_t)match);
+}
+
+JNIEXPORT jint JNICALL
+Java_com_credman_cmwallet_openid4vp_DcqlEngine_nativeQueryCount(JNIEnv* env, jobject thiz, jlong match) {
+    (void)env; (void)thiz;
+    return DcqlMatchQueryCount(MATCH(match));
+}
+
+JNIEXPORT jbyteArray JNICALL
+Java_com_credman_cmwallet_openid4vp_DcqlEngine_nativeQueryId(JNIEnv* env, jobject thiz, jlong match, jint query) {
+    (void)thiz;
+    return NewBytes(env, DcqlMatchQueryId(MATCH(match), query));
+}
+
+JNIEXPORT jint JNICALL
+Java_com_credman_cmwallet_openid4vp_DcqlEngine_nativeCredentialCount(JNIEnv* env, jobject thiz, jlong match, jint query) {
+    (void)env; (void)thiz;
+    return DcqlMatchCredentialCount(MATCH(match), query);
+}
+
+JNIEXPORT jbyteArray JNICALL
+Java_com_credman_cmwallet_openid4vp_DcqlEngine_nativeCredentialId(JNIEnv* env, jobject thiz, jlong match, jint query, jint credential) {
+    (void)thiz;
+    return NewBytes(env, DcqlMatchCredentialId(MATCH(match), query, credential));
+}
+
+JNIEXPORT jint JNICALL
+Java_com_credman_cmwallet_openid4vp_DcqlEngine_nativeClaimSet(JNIEnv* env, jobject thiz, jlong match, jint query, jint credential) {
+    (void)env; (void)thiz;
+    return DcqlMatchClaimSet(MATCH(match), query, credential);
+}
+
+JNIEXPORT jint JNICALL
+Java_com_credman_cmwallet_openid4vp_DcqlEngine_nativeClaimCount(JNIEnv* env, jobject thiz, jlong match, jint query, jint credential) {
+    (void)env; (void)thiz;
+    return DcqlMatchClaimCount(MATCH(match), query, credential);
+}
+
+JNIEXPORT jbyteArray JNICALL
+Java_com_credman_cmwallet_openid4vp_DcqlEngine_nativeClaimDisplay(JNIEnv* env, jobject thiz, jlong match, jint query, jint credential, jint claim) {
+    (void)thiz;
+    return NewBytes(env, DcqlMatchClaimDisplay(MATCH(match), query, credential, claim));
+}
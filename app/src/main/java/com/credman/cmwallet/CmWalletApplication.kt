@@ -17,9 +17,10 @@ import com.credman.cmwallet.data.repository.CredentialRepository.Companion.LENGT
 import com.credman.cmwallet.data.repository.CredentialRepository.Companion.START
 import com.credman.cmwallet.data.repository.CredentialRepository.Companion.SUBTITLE
 import com.credman.cmwallet.data.repository.CredentialRepository.Companion.TITLE
-import com.credman.cmwallet.data.repository.CredentialRepository.RegistryIcon
 import com.credman.cmwallet.data.room.CredentialDatabase
 import com.credman.cmwallet.mdoc.MDoc
+import com.credman.cmwallet.openid4vci.data.CredentialConfigurationUnknownFormat
+import com.credman.cmwallet.openid4vci.data.CredentialOffer
 import com.google.android.gms.identitycredentials.IdentityCredentialClient
 import com.google.android.gms.identitycredentials.IdentityCredentialManager
 import com.google.android.gms.identitycredentials.RegisterCreationOptionsRequest
@@ -27,6 +28,7 @@ import kotlinx.coroutines.CoroutineScope
 import kotlinx.coroutines.Dispatchers
 import kotlinx.coroutines.SupervisorJob
 import kotlinx.coroutines.launch
+import kotlinx.serialization.json.Json
 import org.json.JSONObject
 import java.io.ByteArrayOutputStream
 import java.nio.ByteBuffer
@@ -87,42 +89,38 @@ class CmWalletApplication : Application() {
                 Log.i(TAG, "Credentials changed $credentialDatabase")
                 // Oid4vp draft 24
                 // For backward compatibility with Chrome
-                registryManager.registerCredentials(
-                    request = object : RegisterCredentialsRequest(
-                        "com.credman.IdentityCredential",
-                        "openid4vp",
-                        credentialDatabase,
-                        openId4VPDraft24Matcher
-                    ) {}
+                credentialRepo.registerCredentials(
+                    registryManager,
+                    "com.credman.IdentityCredential",
+                    "openid4vp",
+                    credentialDatabase,
+                    openId4VPDraft24Matcher
                 )
                 // In the future, should only register this type
-                registryManager.registerCredentials(
-                    request = object : RegisterCredentialsRequest(
-                        DigitalCredential.TYPE_DIGITAL_CREDENTIAL,
-                        "openid4vp",
-                        credentialDatabase,
-                        openId4VPDraft24Matcher
-                    ) {}
+                credentialRepo.registerCredentials(
+                    registryManager,
+                    DigitalCredential.TYPE_DIGITAL_CREDENTIAL,
+                    "openid4vp",
+                    credentialDatabase,
+                    openId4VPDraft24Matcher
                 )
 
                 // Oid4vp 1.0 Candidate
                 // For backward compatibility with Chrome
-                registryManager.registerCredentials(
-                    request = object : RegisterCredentialsRequest(
-                        "com.credman.IdentityCredential",
-                        "openid4vp1.0",
-                        credentialDatabase,
-                        openId4VP1_0Matcher
-                    ) {}
+                credentialRepo.registerCredentials(
+                    registryManager,
+                    "com.credman.IdentityCredential",
+                    "openid4vp1.0",
+                    credentialDatabase,
+                    openId4VP1_0Matcher
                 )
                 // In the future, should only register this type
-                registryManager.registerCredentials(
-                    request = object : RegisterCredentialsRequest(
-                        DigitalCredential.TYPE_DIGITAL_CREDENTIAL,
-                        "openid4vp1.0",
-                        credentialDatabase,
-                        openId4VP1_0Matcher
-                    ) {}
+                credentialRepo.registerCredentials(
+                    registryManager,
+                    DigitalCredential.TYPE_DIGITAL_CREDENTIAL,
+                    "openid4vp1.0",
+                    credentialDatabase,
+                    openId4VP1_0Matcher
                 )
 
                 // Phone number verification demo
@@ -162,12 +160,23 @@ class CmWalletApplication : Application() {
         return data
     }
 
-    private fun loadOpenId4VPDraft24Matcher(): ByteArray {
-        return readAsset("openid4vp.wasm")
+    /**
+     * Loads [name].wasm along with the snapshots pre-initialized from it, stored as
+     * preinit/[name]/<content hash of the registry database>.wasm, see make install-preinit.
+     */
+    private fun loadMatcher(name: String): CredentialRepository.Matcher {
+        val preinitialized = assets.list("preinit/$name").orEmpty()
+            .filter { it.endsWith(".wasm") }
+            .associate { Pair(it.removeSuffix(".wasm"), readAsset("preinit/$name/$it")) }
+        return CredentialRepository.Matcher(readAsset("$name.wasm"), preinitialized)
     }
 
-    private fun loadOpenId4VP1_0Matcher(): ByteArray {
-        return readAsset("openid4vp1_0.wasm")
+    private fun loadOpenId4VPDraft24Matcher(): CredentialRepository.Matcher {
+        return loadMatcher("openid4vp")
+    }
+
+    private fun loadOpenId4VP1_0Matcher(): CredentialRepository.Matcher {
+        return loadMatcher("openid4vp1_0")
     }
 
     private fun buildIssuanceData(): ByteArray {
@@ -179,18 +188,40 @@ class CmWalletApplication : Application() {
             icon = iconBuffer.toByteArray(),
             title = resources.getString(R.string.app_name),
             subtitle = "Save your document to CMWallet",
-            issuerAllowlist = listOf("https://digital-credentials.dev", "http://localhost:8080")
+            issuerCapabilities = issuerCapabilities()
         )
 
         return data.toRegistryDatabase()
     }
 
+    /**
+     * The credential configurations the wallet can be provisioned with, by issuer. Those of the
+     * issuer of the bundled offer are its configurations in a format the wallet holds. The
+     * configurations of digital-credentials.dev are only known from the offer, so it may offer any.
+     */
+    private fun issuerCapabilities(): Map<String, Set<String>?> {
+        val json = Json {
+            explicitNulls = false
+            ignoreUnknownKeys = true
+        }
+        val offer: CredentialOffer = json.decodeFromString(loadOpenId4VCIRequestJson().decodeToString())
+        val metadata = offer.issuerMetadata
+        return mapOf(
+            Pair("https://digital-credentials.dev", null),
+            Pair(
+                metadata.credentialIssuer,
+                metadata.credentialConfigurationsSupported
+                    .filterValues { it !is CredentialConfigurationUnknownFormat }.keys
+            ),
+        )
+    }
+
     private fun loadIssuanceMatcher(): ByteArray {
-        return readAsset("provision_hardcoded.wasm")
+        return readAsset("provision.wasm")
     }
 
-    private fun loadPhoneNumberMatcher(): ByteArray {
-        return readAsset("pnv.wasm")
+    private fun loadPhoneNumberMatcher(): CredentialRepository.Matcher {
+        return loadMatcher("pnv")
     }
 
     private fun loadTestCredentialsNew(): ByteArray {
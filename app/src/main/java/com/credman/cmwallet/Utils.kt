@@ -102,6 +102,31 @@ fun PublicKey.toJWK(): JsonElement {
     }
 }
 
+/** Tag, content offset and content length of the DER item at [offset]. */
+private fun readDerItem(der: ByteArray, offset: Int): Triple<Int, Int, Int> {
+    var start = offset + 2
+    var length = der[offset + 1].toInt() and 0xFF
+    if (length and 0x80 != 0) {
+        val lengthBytes = length and 0x7F
+        length = 0
+        repeat(lengthBytes) { length = (length shl 8) or (der[start++].toInt() and 0xFF) }
+    }
+    return Triple(der[offset].toInt() and 0xFF, start, length)
+}
+
+/** The keyIdentifier of the authority key identifier extension, null if there is none. */
+fun X509Certificate.authorityKeyIdentifier(): ByteArray? {
+    // OCTET STRING { SEQUENCE { [0] keyIdentifier OPTIONAL, ... } }
+    val extension = getExtensionValue("2.5.29.35") ?: return null
+    val (_, sequenceOffset, _) = readDerItem(extension, 0)
+    val (_, keyIdentifierOffset, sequenceLength) = readDerItem(extension, sequenceOffset)
+    if (sequenceLength == 0) {
+        return null
+    }
+    val (tag, start, length) = readDerItem(extension, keyIdentifierOffset)
+    return if (tag == 0x80) extension.copyOfRange(start, start + length) else null
+}
+
 @OptIn(ExperimentalEncodingApi::class)
 fun ByteArray.toBase64UrlNoPadding(): String {
     return Base64.UrlSafe.withPadding(Base64.PaddingOption.ABSENT).encode(this)
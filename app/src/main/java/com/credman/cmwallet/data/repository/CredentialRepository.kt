@@ -9,6 +9,7 @@ import androidx.credentials.ExperimentalDigitalCredentialApi
 import androidx.credentials.registry.provider.RegisterCredentialsRequest
 import androidx.credentials.registry.provider.RegistryManager
 import com.credman.cmwallet.R
+import com.credman.cmwallet.authorityKeyIdentifier
 import com.credman.cmwallet.data.model.CredentialDisplayData
 import com.credman.cmwallet.data.model.CredentialItem
 import com.credman.cmwallet.data.model.CredentialKeySoftware
@@ -22,7 +23,9 @@ import com.credman.cmwallet.openid4vci.data.CredentialConfigurationMDoc
 import com.credman.cmwallet.openid4vci.data.CredentialConfigurationSdJwtVc
 import com.credman.cmwallet.openid4vci.data.CredentialConfigurationUnknownFormat
 import com.credman.cmwallet.pnv.PnvTokenRegistry
+import com.credman.cmwallet.sdjwt.Jwt
 import com.credman.cmwallet.sdjwt.SdJwt
+import com.credman.cmwallet.toBase64UrlNoPadding
 import kotlinx.coroutines.flow.Flow
 import kotlinx.coroutines.flow.combine
 import kotlinx.coroutines.flow.emitAll
@@ -30,9 +33,12 @@ import kotlinx.coroutines.flow.flow
 import kotlinx.coroutines.flow.map
 import org.json.JSONArray
 import org.json.JSONObject
+import java.io.ByteArrayInputStream
 import java.io.ByteArrayOutputStream
 import java.nio.ByteBuffer
 import java.nio.ByteOrder
+import java.security.cert.CertificateFactory
+import java.security.cert.X509Certificate
 import kotlin.io.encoding.ExperimentalEncodingApi
 
 class CredentialRepository {
@@ -83,29 +89,51 @@ class CredentialRepository {
     }
 
     @OptIn(ExperimentalDigitalCredentialApi::class)
-    suspend fun registerPhoneNumberVerification(registryManager: RegistryManager, pnvMatcher: ByteArray) {
+    suspend fun registerPhoneNumberVerification(registryManager: RegistryManager, pnvMatcher: Matcher) {
         val testPhoneNumberTokens = listOf(
             PnvTokenRegistry.TEST_PNV_1_GET_PHONE_NUMBER,
             PnvTokenRegistry.TEST_PNV_1_VERIFY_PHONE_NUMBER,
             PnvTokenRegistry.TEST_PNV_2_VERIFY_PHONE_NUMBER
         )
+        val registryDatabase = PnvTokenRegistry.buildRegistryDatabase(testPhoneNumberTokens)
 
         // For chrome < 138. Should be removed soon
-        registryManager.registerCredentials(
-            request = object : RegisterCredentialsRequest(
-                "com.credman.IdentityCredential",
-                "openid4vp1.0-pnv",
-                PnvTokenRegistry.buildRegistryDatabase(testPhoneNumberTokens),
-                pnvMatcher
-            ) {}
+        registerCredentials(
+            registryManager,
+            "com.credman.IdentityCredential",
+            "openid4vp1.0-pnv",
+            registryDatabase,
+            pnvMatcher
         )
         // For native apps and chrome 138+
+        registerCredentials(
+            registryManager,
+            DigitalCredential.TYPE_DIGITAL_CREDENTIAL,
+            "openid4vp1.0-pnv",
+            registryDatabase,
+            pnvMatcher
+        )
+    }
+
+    /**
+     * Registers [registryDatabase] under [type] and [id]. If [matcher] has a snapshot that was
+     * pre-initialized with this database, that snapshot is registered instead of the plain module
+     * so the matcher starts with the registry already parsed.
+     */
+    @OptIn(ExperimentalDigitalCredentialApi::class)
+    suspend fun registerCredentials(
+        registryManager: RegistryManager,
+        type: String,
+        id: String,
+        registryDatabase: ByteArray,
+        matcher: Matcher
+    ) {
         registryManager.registerCredentials(
             request = object : RegisterCredentialsRequest(
-                DigitalCredential.TYPE_DIGITAL_CREDENTIAL,
-                "openid4vp1.0-pnv",
-                PnvTokenRegistry.buildRegistryDatabase(testPhoneNumberTokens),
-                pnvMatcher
+                type,
+                id,
+                registryDatabase,
+                matcher.forRegistryDatabase(registryDatabase)
             ) {}
         )
     }
@@ -119,7 +147,7 @@ class CredentialRepository {
         val icon: ByteArray, // Entry icon for display
         val title: String, // Entry subtitle for display
         val subtitle: String?, // Entry subtitle for display
-        val issuerAllowlist: List<String>,
+        val issuerCapabilities: Map<String, Set<String>?>, // Issuer to its credential configuration ids, null for any
     ) {
         fun toRegistryDatabase(): ByteArray {
             val out = ByteArrayOutputStream()
@@ -144,31 +172,238 @@ class CredentialRepository {
                     } // Hardcoded for now
                     put(ICON, iconJson)
                 })
-                val capabilities = JSONObject()
-                for (iss in issuerAllowlist) {
-                    capabilities.put(iss, JSONObject())
-                }
-                put("capabilities", capabilities)
+                // The issuers as a hash list and the configuration ids of each in the same order, null
+                // for issuers offering any, see OfferSupported in matcher/issuance/provision.c
+                val issuers = issuerCapabilities.entries
+                    .groupBy({ fnv1a(it.key.toByteArray()) }, { it.value })
+                    .toSortedMap()
+                put("capabilities", JSONObject().apply {
+                    put("issuer_hashes", hashList(issuerCapabilities.keys))
+                    put("configuration_ids", JSONArray(issuers.values.map { ids ->
+                        if (ids.contains(null)) JSONObject.NULL else hashList(ids.flatMap { it!! })
+                    }))
+                    // The provision.wasm in the assets predates the hashes and only looks the
+                    // issuer up as a key. Drop them once it is rebuilt.
+                    for (issuer in issuerCapabilities.keys) {
+                        put(issuer, JSONObject())
+                    }
+                })
             }
             out.write(json.toString().toByteArray())
             return out.toByteArray()
         }
     }
 
-    class RegistryIcon(
-        val iconValue: ByteArray,
-        var iconOffset: Int = 0
-    )
+    /**
+     * A matcher wasm module together with its pre-initialized snapshots, keyed by the content hash
+     * (8 hex digits) in the [RegistrySummary] of the registry database each was taken with. The
+     * matcher checks the hash again and reads the registry from the host if it differs, see
+     * matcher/registry.c.
+     */
+    class Matcher(
+        val wasm: ByteArray,
+        val preinitialized: Map<String, ByteArray> = emptyMap(),
+    ) {
+        fun forRegistryDatabase(registryDatabase: ByteArray): ByteArray {
+            if (preinitialized.isEmpty()) {
+                return wasm
+            }
+            val hash = RegistrySummary.contentHash(registryDatabase) ?: return wasm
+            return preinitialized["%08x".format(hash.toLong())] ?: wasm
+        }
+    }
+
+    /**
+     * The icons of a registry database. Each distinct icon is written once and credentials
+     * reference it by its index in the top level [ICONS] table, see matcher/registry.h.
+     *
+     * The matchers in the assets predate the table and only read {start, length} ranges, so
+     * [putRanges] replaces the indices by the ranges of the shared icons until they are rebuilt.
+     */
+    class RegistryIcons {
+        // ByteBuffer equality and hash code are over the content, so identical icons share an id.
+        private val ids = HashMap<ByteBuffer, Int>()
+        private val icons = ArrayList<ByteArray>()
+
+        val size: Int
+            get() = icons.sumOf { it.size }
+
+        /** Returns the id of [icon], adding it if no identical icon was added before. */
+        fun add(icon: ByteArray): Int = ids.getOrPut(ByteBuffer.wrap(icon)) {
+            icons.add(icon)
+            icons.size - 1
+        }
+
+        /** Writes the icons to [out] starting at blob offset [start] and returns the [ICONS] table. */
+        fun write(out: ByteArrayOutputStream, start: Int): JSONArray {
+            val table = JSONArray()
+            var offset = start
+            icons.forEach {
+                out.write(it)
+                table.put(JSONObject().apply {
+                    put(START, offset)
+                    put(LENGTH, it.size)
+                })
+                offset += it.size
+            }
+            return table
+        }
+
+        /** Replaces the [ICON] index of every credential under [credentials] by its range in [table]. */
+        fun putRanges(credentials: JSONObject, table: JSONArray) {
+            credentials.keys().forEach { format ->
+                val types = credentials.getJSONObject(format)
+                types.keys().forEach { type ->
+                    val entries = types.getJSONArray(type)
+                    for (i in 0 until entries.length()) {
+                        val entry = entries.getJSONObject(i)
+                        entry.put(ICON, table.getJSONObject(entry.getInt(ICON)))
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Summary of a registry database's [CREDENTIALS], written right after the json offset so that
+     * matchers can rule out requests for formats and types the wallet doesn't hold without
+     * reading the rest of the blob, see matcher/registry.h.
+     */
+    class RegistrySummary(credentials: JSONObject) {
+        private var formats = 0
+        private val typeHashes: List<UInt>
+
+        init {
+            val hashes = HashSet<UInt>()
+            credentials.keys().forEach { format ->
+                val types = credentials.getJSONObject(format)
+                if (types.length() > 0) {
+                    formats = formats or (SUMMARY_FORMATS[format] ?: SUMMARY_FORMAT_OTHER)
+                }
+                types.keys().forEach { hashes.add(fnv1a(it.toByteArray())) }
+            }
+            typeHashes = hashes.sorted()
+        }
+
+        val size: Int
+            get() = 20 + 4 * typeHashes.size
+
+        /** Writes the summary of a registry whose blob continues with [content]. */
+        fun write(out: ByteArrayOutputStream, content: ByteArray) {
+            val buffer = ByteBuffer.allocate(size)
+            buffer.order(ByteOrder.LITTLE_ENDIAN)
+            buffer.put(SUMMARY_MAGIC.toByteArray())
+            buffer.putInt(size)
+            buffer.putInt(formats)
+            buffer.putInt(typeHashes.size)
+            typeHashes.forEach { buffer.putInt(it.toInt()) }
+            buffer.putInt(fnv1a(content).toInt())
+            out.write(buffer.array())
+        }
+
+        companion object {
+            /**
+             * The content hash in the summary of [registryDatabase], null if it has none. Same
+             * checks as ReadContentHash in matcher/registry.c.
+             */
+            fun contentHash(registryDatabase: ByteArray): UInt? {
+                if (registryDatabase.size < 20 ||
+                    !registryDatabase.copyOfRange(4, 8).contentEquals(SUMMARY_MAGIC.toByteArray())
+                ) {
+                    return null
+                }
+                val buffer = ByteBuffer.wrap(registryDatabase).order(ByteOrder.LITTLE_ENDIAN)
+                val summaryLength = buffer.getInt(8).toUInt()
+                val count = buffer.getInt(16).toUInt()
+                if (summaryLength < 20u || summaryLength > (registryDatabase.size - 4).toUInt() ||
+                    count > (summaryLength - 20u) / 4u
+                ) {
+                    return null
+                }
+                return buffer.getInt(20 + 4 * count.toInt()).toUInt()
+            }
+        }
+    }
+
+    /**
+     * Bloom filter of every member path under a credential's [PATHS], which lets matchers skip
+     * credentials lacking a requested claim before resolving its path, see matcher/path_filter.h.
+     */
+    class PathFilter(paths: JSONObject) {
+        private val hashes = ArrayList<UInt>()
+
+        init {
+            walk(paths, FNV_OFFSET)
+        }
+
+        // A path hashes as its components, each followed by a zero byte.
+        private fun walk(node: JSONObject, parentHash: UInt) {
+            node.keys().forEach { key ->
+                val hash = fnv1a(key.toByteArray() + 0.toByte(), parentHash)
+                hashes.add(hash)
+                node.optJSONObject(key)?.let { walk(it, hash) }
+            }
+        }
+
+        fun toJson(): JSONArray {
+            val words = IntArray(((hashes.size * 10 + 31) / 32).coerceIn(1, PATH_FILTER_MAX_WORDS))
+            val bits = (words.size * 32).toUInt()
+            hashes.forEach { hash ->
+                val step = ((hash shr 16) or (hash shl 16)) or 1u
+                for (i in 0u until PATH_FILTER_HASHES) {
+                    val bit = ((hash + i * step) % bits).toInt()
+                    words[bit / 32] = words[bit / 32] or (1 shl (bit % 32))
+                }
+            }
+            return JSONArray().apply { words.forEach { put(it.toUInt().toLong()) } }
+        }
+    }
 
-    private fun JSONObject.putCommon(itemId: String, itemDisplayData: CredentialDisplayData, iconMap: Map<String, RegistryIcon>) {
+    private fun JSONObject.putCommon(itemId: String, itemDisplayData: CredentialDisplayData, iconIds: Map<String, Int>) {
         put(ID, itemId)
         put(TITLE, itemDisplayData.title)
         putOpt(SUBTITLE, itemDisplayData.subtitle)
-        val iconJson = JSONObject().apply {
-            put(START, iconMap[itemId]!!.iconOffset)
-            put(LENGTH, iconMap[itemId]!!.iconValue.size)
+        put(ICON, iconIds[itemId]!!)
+    }
+
+    /**
+     * The authorities a credential can be matched to by DCQL trusted_authorities, as a hash list of
+     * "<type>:<value>", see AuthorityTrusted in matcher/dcql.c. That is the authority key
+     * identifiers of the issuer certificates, and the issuer as an OpenID Federation entity.
+     * Nothing is written when none are known, so the credential stays a candidate for any query.
+     */
+    private fun JSONObject.putAuthorities(issuerCertificates: List<X509Certificate>, iss: String?) {
+        val authorities = issuerCertificates.mapNotNull { it.authorityKeyIdentifier() }
+            .map { "aki:${it.toBase64UrlNoPadding()}" } + listOfNotNull(iss?.let { "openid_federation:$it" })
+        if (authorities.isNotEmpty()) {
+            put(AUTHORITY_HASHES, hashList(authorities))
+        }
+    }
+
+    /**
+     * The display of every claim under [paths], in the order AddAllClaims in matcher/dcql.c finds
+     * them. Matchers show these for queries without claims instead of walking the paths.
+     */
+    private fun claimDisplays(paths: JSONObject, displays: JSONArray = JSONArray()): JSONArray {
+        paths.keys().forEach { key ->
+            paths.optJSONObject(key)?.let { node ->
+                if (node.has(DISPLAY)) displays.put(node.get(DISPLAY)) else claimDisplays(node, displays)
+            }
+        }
+        return displays
+    }
+
+    /**
+     * Sorts the credentials of each type by descending [PRIORITY], the time they were issued, so
+     * that matchers built with an entry limit keep the most recent ones, see NextCandidate in
+     * matcher/dcql.c. Credentials without a priority go last, in the order they were added.
+     */
+    private fun JSONObject.sortByPriority() {
+        keys().asSequence().toList().forEach { type ->
+            val credentials = getJSONArray(type)
+            put(type, JSONArray((0 until credentials.length()).map { credentials.getJSONObject(it) }
+                .sortedByDescending { it.optLong(PRIORITY) }))
         }
-        put(ICON, iconJson)
     }
 
     private fun constructJwtForRegistry(
@@ -187,21 +422,41 @@ class CredentialRepository {
                     constructJwtForRegistry(v, displayConfig, currPath)
                 )
             } else {
-                result.put(
-                    key,
-                    JSONObject().apply {
-                        val displayName = displayConfig?.claims?.firstOrNull{
-                            JSONArray(it.path) == currPath
-                        }?.display?.first()?.name
-                        putOpt(DISPLAY, displayName)
-                        putOpt(VALUE, v)
-                    }
-                )
+                result.put(key, constructClaimForRegistry(v, displayConfig, currPath))
             }
         }
         return result
     }
 
+    /**
+     * A claim that isn't an object. Arrays also get the claims of their elements as [ELEMENTS],
+     * for paths with nulls and indices, see MatchSdJwtClaim in matcher/dcql.c. The display config
+     * names elements with a null component, as in ["nationalities", null] or
+     * ["addresses", null, "street"], so they are looked up under the path of their array and null.
+     */
+    private fun constructClaimForRegistry(
+        v: Any,
+        displayConfig: CredentialConfigurationSdJwtVc?,
+        path: JSONArray,
+    ): JSONObject = JSONObject().apply {
+        val displayName = displayConfig?.claims?.firstOrNull{
+            JSONArray(it.path) == path
+        }?.display?.first()?.name
+        putOpt(DISPLAY, displayName)
+        putOpt(VALUE, v)
+        if (v is JSONArray) {
+            val elementPath = JSONArray(path.toString()).put(JSONObject.NULL)
+            val elements = JSONArray()
+            for (i in 0 until v.length()) {
+                when (val element = v[i]) {
+                    is JSONObject -> elements.put(constructJwtForRegistry(element, displayConfig, elementPath))
+                    else -> elements.put(constructClaimForRegistry(element, displayConfig, elementPath))
+                }
+            }
+            put(ELEMENTS, elements)
+        }
+    }
+
     /**
      * Credential Registry has the following format:
      *
@@ -212,44 +467,78 @@ class CredentialRepository {
      * |------------- More Icons... -----------|
      * |----------- Credential Json -----------|  // See assets/paymentcreds.json as an example
      * |---------------------------------------|
+     *
+     * Identical icons are only written once, see [RegistryIcons].
      */
     @OptIn(ExperimentalEncodingApi::class)
     private fun createRegistryDatabase(items: List<CredentialItem>): ByteArray {
         val out = ByteArrayOutputStream()
 
-        val iconMap: Map<String, RegistryIcon> = items.associate {
-            Pair(
-                it.id,
-                RegistryIcon(it.displayData.icon?.decodeBase64() ?: ByteArray(0))
-            )
+        val icons = RegistryIcons()
+        val iconIds: Map<String, Int> = items.associate {
+            Pair(it.id, icons.add(it.displayData.icon?.decodeBase64() ?: ByteArray(0)))
         }
+        val registryCredentials = createRegistryCredentials(items, iconIds)
+        val summary = RegistrySummary(registryCredentials)
+
         // Write the offset to the json
-        val jsonOffset = 4 + iconMap.values.sumOf { it.iconValue.size }
+        val jsonOffset = 4 + summary.size + icons.size
         val buffer = ByteBuffer.allocate(4)
         buffer.order(ByteOrder.LITTLE_ENDIAN)
         buffer.putInt(jsonOffset)
         out.write(buffer.array())
 
-        // Write the icons
-        var currIconOffset = 4
-        iconMap.values.forEach {
-            it.iconOffset = currIconOffset
-            out.write(it.iconValue)
-            currIconOffset += it.iconValue.size
-        }
+        // Write the icons and the json, then the summary, which hashes them, followed by them
+        val content = ByteArrayOutputStream()
+        val iconTable = icons.write(content, 4 + summary.size)
+        icons.putRanges(registryCredentials, iconTable)
+
+        val registryJson = JSONObject()
+        registryJson.put(CREDENTIALS, registryCredentials)
+        registryJson.put(ICONS, iconTable)
+        Log.d(TAG, "Credential to be registered: ${registryJson.toString(2)}")
+        content.write(registryJson.toString().toByteArray())
+        summary.write(out, content.toByteArray())
+        content.writeTo(out)
+        return out.toByteArray()
+    }
+
+    /**
+     * The credential json of a registry holding [item] alone, for matching it once the user has
+     * selected it, see DcqlEngine. Icons are left out.
+     */
+    fun createDcqlStore(item: CredentialItem): String = JSONObject()
+        .put(CREDENTIALS, createRegistryCredentials(listOf(item), mapOf(Pair(item.id, 0))))
+        .toString()
 
+    /** The "credentials" of the registry json, by format and then doctype or vct. */
+    @OptIn(ExperimentalEncodingApi::class)
+    private fun createRegistryCredentials(items: List<CredentialItem>, iconIds: Map<String, Int>): JSONObject {
         val mdocCredentials = JSONObject()
         val sdJwtCredentials = JSONObject()
         items.forEach { item ->
             when (item.config) {
                 is CredentialConfigurationSdJwtVc -> {
                     val credJson = JSONObject()
-                    credJson.putCommon(item.id, item.displayData, iconMap)
+                    credJson.putCommon(item.id, item.displayData, iconIds)
                     val sdJwtVc = SdJwt(item.credentials.first().credential, (item.credentials.first().key as CredentialKeySoftware).privateKey)
                     val rawJwt = sdJwtVc.verifiedResult.processedJwt
                     val jwtWithDisplay = constructJwtForRegistry(rawJwt, item.config, JSONArray())
                     // TODO: what do we do with non-user-friendly claims such as iss, aud?
                     credJson.put(PATHS, jwtWithDisplay)
+                    credJson.put(PATH_FILTER, PathFilter(jwtWithDisplay).toJson())
+                    credJson.put(DISPLAYS, claimDisplays(jwtWithDisplay))
+                    val x5c = Jwt(sdJwtVc.issuerJwt).header.optJSONArray("x5c") ?: JSONArray()
+                    val factory = CertificateFactory.getInstance("X.509")
+                    credJson.putAuthorities(
+                        (0 until x5c.length()).map {
+                            factory.generateCertificate(ByteArrayInputStream(x5c.getString(it).decodeBase64())) as X509Certificate
+                        },
+                        rawJwt.optString("iss").ifEmpty { null },
+                    )
+                    if (rawJwt.has("iat")) {
+                        credJson.put(PRIORITY, rawJwt.getLong("iat"))
+                    }
                     val vctType = rawJwt["vct"] as String
                     when (val current = sdJwtCredentials.opt(vctType) ?: JSONArray()) {
                         is JSONArray -> sdJwtCredentials.put(vctType, current.put(credJson))
@@ -259,7 +548,7 @@ class CredentialRepository {
                 }
                 is CredentialConfigurationMDoc -> {
                     val credJson = JSONObject()
-                    credJson.putCommon(item.id, item.displayData, iconMap)
+                    credJson.putCommon(item.id, item.displayData, iconIds)
                     val mdoc = MDoc(item.credentials.first().credential.decodeBase64UrlNoPadding())
                     if (mdoc.issuerSignedNamespaces.isNotEmpty()) {
                         val pathJson = JSONObject()
@@ -281,7 +570,11 @@ class CredentialRepository {
                             pathJson.put(namespace, namespaceJson)
                         }
                         credJson.put(PATHS, pathJson)
+                        credJson.put(PATH_FILTER, PathFilter(pathJson).toJson())
+                        credJson.put(DISPLAYS, claimDisplays(pathJson))
                     }
+                    credJson.putAuthorities(mdoc.issuerCertificates, null)
+                    mdoc.signed?.let { credJson.put(PRIORITY, it.epochSecond) }
                     if (Build.VERSION.SDK_INT >= 33) {
                         mdocCredentials.append(item.config.doctype, credJson)
                     } else {
@@ -308,14 +601,12 @@ class CredentialRepository {
                 is CredentialConfigurationUnknownFormat -> TODO()
             }
         }
+        mdocCredentials.sortByPriority()
+        sdJwtCredentials.sortByPriority()
         val registryCredentials = JSONObject()
         registryCredentials.put("mso_mdoc", mdocCredentials)
         registryCredentials.put("dc+sd-jwt", sdJwtCredentials)
-        val registryJson = JSONObject()
-        registryJson.put(CREDENTIALS, registryCredentials)
-        Log.d(TAG, "Credential to be registered: ${registryJson.toString(2)}")
-        out.write(registryJson.toString().toByteArray())
-        return out.toByteArray()
+        return registryCredentials
     }
 
     companion object {
@@ -327,12 +618,49 @@ class CredentialRepository {
         const val TITLE = "title"
         const val SUBTITLE = "subtitle"
         const val ICON = "icon"
+        const val ICONS = "icons"
         const val START = "start"
         const val LENGTH = "length"
         const val NAMESPACES = "namespaces"
         const val PATHS = "paths"
+        const val PATH_FILTER = "path_filter"
         const val VALUE = "value"
         const val DISPLAY = "display"
         const val DISPLAY_VALUE = "display_value"
+        const val ELEMENTS = "elements"
+        const val AUTHORITY_HASHES = "authority_hashes"
+        const val PRIORITY = "priority"
+        const val DISPLAYS = "displays"
+
+        // FNV-1a as in matcher/hash.h
+        const val FNV_OFFSET = 2166136261u
+        const val FNV_PRIME = 16777619u
+
+        fun fnv1a(bytes: ByteArray, hash: UInt = FNV_OFFSET): UInt {
+            var result = hash
+            bytes.forEach {
+                result = (result xor it.toUByte().toUInt()) * FNV_PRIME
+            }
+            return result
+        }
+
+        // Hash lists, see matcher/hash.h
+        fun hashList(values: Collection<String>): String = values.map { fnv1a(it.toByteArray()) }
+            .distinct()
+            .sorted()
+            .joinToString("") { it.toString(16).padStart(8, '0') }
+
+        // Path filters, see matcher/path_filter.h
+        const val PATH_FILTER_HASHES = 3u
+        const val PATH_FILTER_MAX_WORDS = 64
+
+        // Registry summary, see matcher/registry.h
+        const val SUMMARY_MAGIC = "CMRS"
+        val SUMMARY_FORMATS = mapOf(
+            "mso_mdoc" to 0x1,
+            "dc+sd-jwt" to 0x2,
+            "dc-authorization+sd-jwt" to 0x4,
+        )
+        const val SUMMARY_FORMAT_OTHER = 0x80000000.toInt()
     }
 }
\ No newline at end of file
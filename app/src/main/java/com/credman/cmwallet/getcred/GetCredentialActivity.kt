@@ -243,11 +243,11 @@ class GetCredentialActivity : FragmentActivity() {
                         )
                         return
                     }
-                    val selectedEntryId = JSONObject(entryId!!)
-                    Log.d(TAG, "Selected Entry Info:${entryId}")
-                    val providerIdx = if (selectedEntryId.has("req_idx")) selectedEntryId.getInt("req_idx") else selectedEntryId.getInt("provider_idx")
-                    val selectedId = if (selectedEntryId.has("entry_id")) selectedEntryId.getString("entry_id") else selectedEntryId.getString("id")
-                    val dqclCredId = selectedEntryId.getString("dcql_cred_id")
+                    val selectedEntryId = EntryId.decode(entryId!!)
+                    Log.d(TAG, "Selected Entry Info:${selectedEntryId}")
+                    val providerIdx = selectedEntryId.requestIdx
+                    val selectedId = selectedEntryId.credentialId
+                    val dqclCredId = selectedEntryId.dcqlCredentialId
 
                     val pnvResponse = maybeHandlePnv(
                         it.requestJson,
@@ -481,6 +481,53 @@ class GetCredentialActivity : FragmentActivity() {
     }
 }
 
+/**
+ * The id of an entry emitted by the openid4vp matchers, see matcher/entry_id.h for the encoding.
+ * Json ids, as emitted by older matchers and the issuance flow, are still accepted.
+ */
+internal data class EntryId(
+    val requestIdx: Int,
+    val credentialId: String,
+    val dcqlCredentialId: String,
+) {
+    companion object {
+        private const val VERSION: Byte = 1
+
+        fun decode(entryId: String): EntryId {
+            if (entryId.startsWith("{")) {
+                val json = JSONObject(entryId)
+                return EntryId(
+                    if (json.has("req_idx")) json.getInt("req_idx") else json.getInt("provider_idx"),
+                    if (json.has("entry_id")) json.getString("entry_id") else json.getString("id"),
+                    json.getString("dcql_cred_id"),
+                )
+            }
+            val raw = entryId.decodeBase64UrlNoPadding()
+            require(raw.isNotEmpty() && raw[0] == VERSION) { "Unsupported entry id $entryId" }
+            var pos = 1
+            fun readVarint(): Int {
+                var value = 0
+                var shift = 0
+                while (true) {
+                    val byte = raw[pos++].toInt() and 0xff
+                    value = value or ((byte and 0x7f) shl shift)
+                    if (byte < 0x80) return value
+                    shift += 7
+                }
+            }
+            fun readString(): String {
+                val len = readVarint()
+                val value = String(raw, pos, len, Charsets.UTF_8)
+                pos += len
+                return value
+            }
+            val requestIdx = readVarint()
+            val credentialId = readString()
+            return EntryId(requestIdx, credentialId, readString())
+        }
+    }
+}
+
 /**
  * Returns biometric Strong only if it is available. Otherwise, also allows device credentials.
  */
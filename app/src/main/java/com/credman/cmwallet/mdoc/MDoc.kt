@@ -5,9 +5,13 @@ import com.credman.cmwallet.cbor.CborTag
 import com.credman.cmwallet.cbor.cborDecode
 import com.credman.cmwallet.cbor.cborEncode
 import com.credman.cmwallet.convertDerToRaw
+import java.io.ByteArrayInputStream
 import java.security.MessageDigest
 import java.security.PrivateKey
 import java.security.Signature
+import java.security.cert.CertificateFactory
+import java.security.cert.X509Certificate
+import java.time.Instant
 
 fun createSessionTranscript(handover: Any): List<Any?> {
     return listOf(
@@ -47,6 +51,29 @@ class MDoc(
         }
         map
     }
+
+    /** When the issuer signed the mobile security object, null if it can't be read. */
+    val signed: Instant? by lazy {
+        val issuerAuth = issuerSignedDict["issuerAuth"] as? List<*>
+        val payload = issuerAuth?.getOrNull(2) as? ByteArray ?: return@lazy null
+        val mso = ((cborDecode(payload) as? CborTag)?.item as? ByteArray)?.let { cborDecode(it) } as? Map<*, *>
+        val signed = (mso?.get("validityInfo") as? Map<*, *>)?.get("signed")
+        ((signed as? CborTag)?.item as? String)?.let { runCatching { Instant.parse(it) }.getOrNull() }
+    }
+
+    /** The x5chain of the issuerAuth COSE_Sign1, empty if there is none. */
+    val issuerCertificates: List<X509Certificate> by lazy {
+        val issuerAuth = issuerSignedDict["issuerAuth"] as? List<*>
+        val unprotectedHeader = issuerAuth?.getOrNull(1) as? Map<*, *>
+        val x5chain = unprotectedHeader?.entries?.firstOrNull { (it.key as? Number)?.toLong() == 33L }?.value
+        val certificates = when (x5chain) {
+            is ByteArray -> listOf(x5chain)
+            is List<*> -> x5chain.filterIsInstance<ByteArray>()
+            else -> emptyList()
+        }
+        val factory = CertificateFactory.getInstance("X.509")
+        certificates.map { factory.generateCertificate(ByteArrayInputStream(it)) as X509Certificate }
+    }
 }
 
 //fun toCredentialItem(
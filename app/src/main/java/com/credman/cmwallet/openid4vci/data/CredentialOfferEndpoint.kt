@@ -122,7 +122,7 @@ data class ClaimDisplay(
 @Serializable
 data class Claim(
     @SerialName("mandatory") val mandatory: Boolean?,
-    @SerialName("path") val path: List<String>,
+    @SerialName("path") val path: List<String?>, // null selects all elements of an array
     @SerialName("display") val display: List<ClaimDisplay>?,
 )
 
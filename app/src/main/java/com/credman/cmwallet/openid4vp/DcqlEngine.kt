@@ -0,0 +1,70 @@
+package com.credman.cmwallet.openid4vp
+
+import org.json.JSONObject
+
+/**
+ * The DCQL matching of the matchers, matcher/dcql_engine.h, through JNI. Once the user selected a
+ * credential, it is matched against the request again with the same engine and the same registry
+ * json, so the claims presented are the ones its entry showed.
+ */
+object DcqlEngine {
+    init {
+        System.loadLibrary("dcql")
+        check(nativeApiVersion() == API_VERSION) { "Unexpected dcql engine version ${nativeApiVersion()}" }
+    }
+
+    private const val API_VERSION = 1
+
+    data class Match(
+        val dcqlId: String,
+        val credentialId: String,
+        val claimSet: Int?, // index in claim_sets, null for credential queries without them
+        val claimDisplays: List<String?>,
+    )
+
+    /**
+     * Runs [dcqlQuery] against the "credentials" of [registryJson], in the order the matchers
+     * offer the matches. Synchronized as the engine can't run concurrently with itself.
+     */
+    @Synchronized
+    fun match(registryJson: String, dcqlQuery: JSONObject): List<Match> {
+        val store = nativeStoreParse(registryJson.toByteArray())
+        require(store != 0L) { "registry json is invalid" }
+        try {
+            val match = nativeMatchQuery(store, dcqlQuery.toString().toByteArray())
+            require(match != 0L) { "dcql_query is invalid" }
+            try {
+                return (0 until nativeQueryCount(match)).flatMap { query ->
+                    val dcqlId = nativeQueryId(match, query)!!.decodeToString()
+                    (0 until nativeCredentialCount(match, query)).map { credential ->
+                        Match(
+                            dcqlId = dcqlId,
+                            credentialId = nativeCredentialId(match, query, credential)!!.decodeToString(),
+                            claimSet = nativeClaimSet(match, query, credential).takeIf { it >= 0 },
+                            claimDisplays = (0 until nativeClaimCount(match, query, credential)).map {
+                                nativeClaimDisplay(match, query, credential, it)?.decodeToString()
+                            },
+                        )
+                    }
+                }
+            } finally {
+                nativeMatchFree(match)
+            }
+        } finally {
+            nativeStoreFree(store)
+        }
+    }
+
+    private external fun nativeApiVersion(): Int
+    private external fun nativeStoreParse(registryJson: ByteArray): Long
+    private external fun nativeStoreFree(store: Long)
+    private external fun nativeMatchQuery(store: Long, dcqlQuery: ByteArray): Long
+    private external fun nativeMatchFree(match: Long)
+    private external fun nativeQueryCount(match: Long): Int
+    private external fun nativeQueryId(match: Long, query: Int): ByteArray?
+    private external fun nativeCredentialCount(match: Long, query: Int): Int
+    private external fun nativeCredentialId(match: Long, query: Int, credential: Int): ByteArray?
+    private external fun nativeClaimSet(match: Long, query: Int, credential: Int): Int
+    private external fun nativeClaimCount(match: Long, query: Int, credential: Int): Int
+    private external fun nativeClaimDisplay(match: Long, query: Int, credential: Int, claim: Int): ByteArray?
+}
@@ -147,8 +147,8 @@ class OpenId4VP(
         )
     }
 
-    fun matchCredentials(credentialStore: JSONObject): Map<String, List<MatchedCredential>> {
-        return DCQLQuery(dcqlQuery, credentialStore)
+    fun matchCredentials(registryJson: String): List<DcqlEngine.Match> {
+        return DcqlEngine.match(registryJson, dcqlQuery)
     }
 
     fun getDcqlCredentialObject(dcqlId: String): JSONObject? = getDqclCredentialById(dcqlQuery, dcqlId)
@@ -9,9 +9,11 @@ import com.credman.cmwallet.CmWalletApplication.Companion.TAG
 import com.credman.cmwallet.CmWalletApplication.Companion.computeClientId
 import com.credman.cmwallet.createJWTES256
 import com.credman.cmwallet.data.repository.CredentialRepository.Companion.ICON
-import com.credman.cmwallet.data.repository.CredentialRepository.Companion.LENGTH
-import com.credman.cmwallet.data.repository.CredentialRepository.Companion.START
-import com.credman.cmwallet.data.repository.CredentialRepository.RegistryIcon
+import com.credman.cmwallet.data.repository.CredentialRepository.Companion.ICONS
+import com.credman.cmwallet.data.repository.CredentialRepository.Companion.hashList
+import com.credman.cmwallet.data.repository.CredentialRepository.PathFilter
+import com.credman.cmwallet.data.repository.CredentialRepository.RegistryIcons
+import com.credman.cmwallet.data.repository.CredentialRepository.RegistrySummary
 import com.credman.cmwallet.decodeBase64
 import com.credman.cmwallet.getcred.GetCredentialActivity.DigitalCredentialRequestOptions
 import com.credman.cmwallet.getcred.GetCredentialActivity.DigitalCredentialResult
@@ -99,10 +101,12 @@ data class PnvTokenRegistry(
         internal const val SUBTITLE = "subtitle"
         internal const val DISCLAIMER = "disclaimer"
         internal const val PATHS = "paths"
+        internal const val PATH_FILTER = "path_filter"
         internal const val VALUE = "value"
         internal const val DISPLAY = "display"
         internal const val SHARED_ATTRIBUTE_DISPLAY_NAME = "shared_attribute_display_name"
         internal const val ISS_ALLOWLIST = "iss_allowlist"
+        internal const val ISS_ALLOWLIST_HASHES = "iss_allowlist_hashes"
 
         val TEST_PNV_1_GET_PHONE_NUMBER = PnvTokenRegistry(
             tokenId = "pnv_1",
@@ -141,27 +145,13 @@ data class PnvTokenRegistry(
         fun buildRegistryDatabase(items: List<PnvTokenRegistry>): ByteArray {
             val out = ByteArrayOutputStream()
 
-            val iconMap: Map<String, RegistryIcon> = items.associate {
-                Pair(
-                    it.tokenId,
-                    RegistryIcon(it.icon?.decodeBase64() ?: ByteArray(0))
-                )
+            val icons = RegistryIcons()
+            val iconIds: Map<String, Int> = items.associate {
+                Pair(it.tokenId, icons.add(it.icon?.decodeBase64() ?: ByteArray(0)))
             }
 
-            // Write the offset to the json
-            val jsonOffset = 4 + iconMap.values.sumOf { it.iconValue.size }
-            val buffer = ByteBuffer.allocate(4)
-            buffer.order(ByteOrder.LITTLE_ENDIAN)
-            buffer.putInt(jsonOffset)
-            out.write(buffer.array())
-
-            // Write the icons
-            var currIconOffset = 4
-            iconMap.values.forEach {
-                it.iconOffset = currIconOffset
-                out.write(it.iconValue)
-                currIconOffset += it.iconValue.size
-            }
+            // Tokens of the same carrier share their allowlist, each distinct one is encoded once
+            val issAllowlists = HashMap<Set<String>, String>()
 
             val sdJwtCredentials = JSONObject()
             for (item in items) {
@@ -169,6 +159,11 @@ data class PnvTokenRegistry(
                 val credJson = JSONObject()
                 credJson.put(SHARED_ATTRIBUTE_DISPLAY_NAME, item.phoneNumberAttributeDisplayName)
                 if (item.supportedAggregatorIssNames != null) {
+                    credJson.put(ISS_ALLOWLIST_HASHES, issAllowlists.getOrPut(item.supportedAggregatorIssNames) {
+                        hashList(item.supportedAggregatorIssNames)
+                    })
+                    // The hashes only rule issuers out, this object is what allows one, see
+                    // IssAllowed in matcher/pnv/dcql.c. The pnv.wasm in the assets reads it alone.
                     val issAllowlist = JSONObject()
                     for (issName in item.supportedAggregatorIssNames) {
                         issAllowlist.put(issName, JSONObject())
@@ -179,17 +174,14 @@ data class PnvTokenRegistry(
                 credJson.put(TITLE, sdJwtRegistryItem.displayData.title)
                 credJson.putOpt(SUBTITLE, sdJwtRegistryItem.displayData.subtitle)
                 credJson.putOpt(DISCLAIMER, sdJwtRegistryItem.displayData.description)
-                val iconJson = JSONObject().apply {
-                    put(START, iconMap[sdJwtRegistryItem.id]!!.iconOffset)
-                    put(LENGTH, iconMap[sdJwtRegistryItem.id]!!.iconValue.size)
-                }
-                credJson.putOpt(ICON, iconJson)
+                credJson.put(ICON, iconIds[sdJwtRegistryItem.id]!!)
                 val paths = JSONObject()
                 for (claim in sdJwtRegistryItem.claims) {
                     paths.put(claim.path, JSONObject().putOpt(DISPLAY, claim.display).putOpt(VALUE, claim.value))
                 }
 
                 credJson.put(PATHS, paths)
+                credJson.put(PATH_FILTER, PathFilter(paths).toJson())
                 val vctType = item.vct
                 when (val current = sdJwtCredentials.opt(vctType) ?: JSONArray()) {
                     is JSONArray -> sdJwtCredentials.put(vctType, current.put(credJson))
@@ -198,10 +190,27 @@ data class PnvTokenRegistry(
             }
             val registryCredentials = JSONObject()
             registryCredentials.put(PNV_CRED_FORMAT, sdJwtCredentials)
+            val summary = RegistrySummary(registryCredentials)
+
+            // Write the offset to the json
+            val jsonOffset = 4 + summary.size + icons.size
+            val buffer = ByteBuffer.allocate(4)
+            buffer.order(ByteOrder.LITTLE_ENDIAN)
+            buffer.putInt(jsonOffset)
+            out.write(buffer.array())
+
+            // Write the icons and the json, then the summary, which hashes them, followed by them
+            val content = ByteArrayOutputStream()
+            val iconTable = icons.write(content, 4 + summary.size)
+            icons.putRanges(registryCredentials, iconTable)
+
             val registryJson = JSONObject()
             registryJson.put(CREDENTIALS, registryCredentials)
+            registryJson.put(ICONS, iconTable)
             Log.d(TAG, "Phone Number to be registered:\n$registryJson")
-            out.write(registryJson.toString().toByteArray())
+            content.write(registryJson.toString().toByteArray())
+            summary.write(out, content.toByteArray())
+            content.writeTo(out)
             return out.toByteArray()
         }
     }
@@ -21,14 +21,15 @@ static int B64Lookup(char x) {
 int B64DecodeURL(char* input, char** output) {
     int b64len = strlen(input);
     int output_len = (b64len*3) / 4;
-    char* buffer = malloc(output_len+1);
+    // Unpadded input ends in a partial group, decoded as if padded with zero bits
+    char* buffer = malloc((b64len + 3) / 4 * 3 + 1);
     
     int count = 0;
     for(int i=0; i<b64len; i+=4) {
         uint32_t v = 0;
         for(int j=0; j<4; j++) {
             v = v << 6;
-            v += B64Lookup(input[i+j]);
+            v += i+j < b64len ? B64Lookup(input[i+j]) : 0;
         }
         buffer[count++] = (v >> 16);
         buffer[count++] = (v >> 8) & 0xff;
@@ -42,7 +43,57 @@ int B64DecodeURL(char* input, char** output) {
     if (b64len > 1 && input[b64len-2] == '=') {
         output_len--;
     }
+    buffer[output_len] = '\0';
 
 
     return output_len;
 }
+
+static const char B64URLAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+// Padded output so that it round trips through B64DecodeURL.
+int B64EncodeURL(const unsigned char* input, int input_len, char** output) {
+    int output_len = ((input_len + 2) / 3) * 4;
+    char* buffer = malloc(output_len + 1);
+
+    int count = 0;
+    for (int i=0; i<input_len; i+=3) {
+        uint32_t v = input[i] << 16;
+        if (i+1 < input_len) {
+            v |= input[i+1] << 8;
+        }
+        if (i+2 < input_len) {
+            v |= input[i+2];
+        }
+        buffer[count++] = B64URLAlphabet[(v >> 18) & 0x3f];
+        buffer[count++] = B64URLAlphabet[(v >> 12) & 0x3f];
+        buffer[count++] = i+1 < input_len ? B64URLAlphabet[(v >> 6) & 0x3f] : '=';
+        buffer[count++] = i+2 < input_len ? B64URLAlphabet[v & 0x3f] : '=';
+    }
+    buffer[count] = '\0';
+    *output = buffer;
+    return output_len;
+}
+
+int B64EncodeURLNoPadding(const unsigned char* input, int input_len, char* output) {
+    int count = 0;
+    for (int i=0; i<input_len; i+=3) {
+        uint32_t v = input[i] << 16;
+        if (i+1 < input_len) {
+            v |= input[i+1] << 8;
+        }
+        if (i+2 < input_len) {
+            v |= input[i+2];
+        }
+        output[count++] = B64URLAlphabet[(v >> 18) & 0x3f];
+        output[count++] = B64URLAlphabet[(v >> 12) & 0x3f];
+        if (i+1 < input_len) {
+            output[count++] = B64URLAlphabet[(v >> 6) & 0x3f];
+        }
+        if (i+2 < input_len) {
+            output[count++] = B64URLAlphabet[v & 0x3f];
+        }
+    }
+    output[count] = '\0';
+    return count;
+}
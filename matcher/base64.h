@@ -1,6 +1,12 @@
 #ifndef BASE64_H
 #define BASE64_H
 
+// Padded or unpadded input. The output is NUL terminated, the returned length excludes the NUL.
 int B64DecodeURL(char* input, char** output);
 
+int B64EncodeURL(const unsigned char* input, int input_len, char** output);
+
+// Unpadded, into a caller provided buffer of at least (input_len * 4 + 2) / 3 + 1 bytes.
+int B64EncodeURLNoPadding(const unsigned char* input, int input_len, char* output);
+
 #endif
@@ -0,0 +1,251 @@
+#include <stdlib.h>
+#include <string.h>
+
+#define CREDMAN_HOST_IMPL
+#include "credentialmanager.h"
+
+#include "batch.h"
+
+typedef struct BatchBuffer {
+    uint8_t* data;
+    size_t len;
+    size_t cap;
+} BatchBuffer;
+
+static BatchBuffer batch;
+
+static void BatchPutRaw(const void* bytes, size_t len) {
+    if (batch.len + len > batch.cap) {
+        size_t cap = batch.cap == 0 ? 4096 : batch.cap;
+        while (cap < batch.len + len) {
+            cap *= 2;
+        }
+        batch.data = realloc(batch.data, cap);
+        batch.cap = cap;
+    }
+    memcpy(batch.data + batch.len, bytes, len);
+    batch.len += len;
+}
+
+static void BatchPutU32(uint32_t value) {
+    uint8_t bytes[4];
+    for (int i=0; i<4; i++) {
+        bytes[i] = (value >> (8 * i)) & 0xff;
+    }
+    BatchPutRaw(bytes, 4);
+}
+
+static void BatchPutString(const char* value) {
+    if (value == NULL) {
+        BatchPutU32(BATCH_NULL_STRING);
+        return;
+    }
+    size_t len = strlen(value);
+    BatchPutU32(len);
+    BatchPutRaw(value, len + 1);
+}
+
+static void BatchPutIcon(const char* icon, size_t icon_len) {
+    if (icon == NULL) {
+        icon_len = 0;
+    }
+    BatchPutU32(icon_len);
+    BatchPutRaw(icon, icon_len);
+}
+
+static size_t BatchBeginCall(uint8_t kind) {
+    if (batch.data == NULL) {
+        BatchPutRaw(BATCH_MAGIC, 4);
+        BatchPutU32(BATCH_VERSION);
+        atexit(BatchFlush);
+    }
+    BatchPutRaw(&kind, 1);
+    size_t call = batch.len;
+    BatchPutU32(0); // Patched by BatchEndCall
+    return call;
+}
+
+static void BatchEndCall(size_t call) {
+    uint32_t len = batch.len - call - 4;
+    for (int i=0; i<4; i++) {
+        batch.data[call + i] = (len >> (8 * i)) & 0xff;
+    }
+}
+
+void BatchAddStringIdEntry(char *cred_id, char* icon, size_t icon_len, char *title, char *subtitle, char *disclaimer, char *warning) {
+    size_t call = BatchBeginCall(BATCH_STRING_ID_ENTRY);
+    BatchPutString(cred_id);
+    BatchPutIcon(icon, icon_len);
+    BatchPutString(title);
+    BatchPutString(subtitle);
+    BatchPutString(disclaimer);
+    BatchPutString(warning);
+    BatchEndCall(call);
+}
+
+void BatchAddFieldForStringIdEntry(char *cred_id, char *field_display_name, char *field_display_value) {
+    size_t call = BatchBeginCall(BATCH_FIELD);
+    BatchPutString(cred_id);
+    BatchPutString(field_display_name);
+    BatchPutString(field_display_value);
+    BatchEndCall(call);
+}
+
+void BatchAddPaymentEntry(char *cred_id, char *merchant_name, char *payment_method_name, char *payment_method_subtitle, char* payment_method_icon, size_t payment_method_icon_len, char *transaction_amount, char* bank_icon, size_t bank_icon_len, char* payment_provider_icon, size_t payment_provider_icon_len) {
+    size_t call = BatchBeginCall(BATCH_PAYMENT_ENTRY);
+    BatchPutString(cred_id);
+    BatchPutString(merchant_name);
+    BatchPutString(payment_method_name);
+    BatchPutString(payment_method_subtitle);
+    BatchPutIcon(payment_method_icon, payment_method_icon_len);
+    BatchPutString(transaction_amount);
+    BatchPutIcon(bank_icon, bank_icon_len);
+    BatchPutIcon(payment_provider_icon, payment_provider_icon_len);
+    BatchEndCall(call);
+}
+
+void BatchSetAdditionalDisclaimerAndUrlForVerificationEntry(char *cred_id, char *secondary_disclaimer, char *url_display_text, char *url_value) {
+    size_t call = BatchBeginCall(BATCH_VERIFICATION_DISCLAIMER);
+    BatchPutString(cred_id);
+    BatchPutString(secondary_disclaimer);
+    BatchPutString(url_display_text);
+    BatchPutString(url_value);
+    BatchEndCall(call);
+}
+
+void BatchFlush(void) {
+    if (batch.len == 0) {
+        return;
+    }
+    if (!AddEntriesBatch(batch.data, batch.len)) {
+        BatchEmit(batch.data, batch.len);
+    }
+    free(batch.data);
+    batch.data = NULL;
+    batch.len = 0;
+    batch.cap = 0;
+}
+
+typedef struct BatchReader {
+    const uint8_t* data;
+    size_t len;
+    size_t pos;
+    int ok;
+} BatchReader;
+
+static uint32_t ReadU32(const uint8_t* bytes) {
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static uint32_t BatchGetU32(BatchReader* reader) {
+    if (reader->pos + 4 > reader->len) {
+        reader->ok = 0;
+        return 0;
+    }
+    uint32_t value = ReadU32(reader->data + reader->pos);
+    reader->pos += 4;
+    return value;
+}
+
+static char* BatchGetString(BatchReader* reader) {
+    uint32_t len = BatchGetU32(reader);
+    if (!reader->ok || len == BATCH_NULL_STRING) {
+        return NULL;
+    }
+    if (len >= reader->len - reader->pos || reader->data[reader->pos + len] != '\0') {
+        reader->ok = 0;
+        return NULL;
+    }
+    char* value = (char*)reader->data + reader->pos;
+    reader->pos += len + 1;
+    return value;
+}
+
+static char* BatchGetIcon(BatchReader* reader, size_t* icon_len) {
+    uint32_t len = BatchGetU32(reader);
+    *icon_len = 0;
+    if (!reader->ok || len > reader->len - reader->pos) {
+        reader->ok = 0;
+        return NULL;
+    }
+    char* icon = len == 0 ? NULL : (char*)reader->data + reader->pos;
+    reader->pos += len;
+    *icon_len = len;
+    return icon;
+}
+
+int BatchEmit(const uint8_t* data, size_t len) {
+    if (len < 8 || memcmp(data, BATCH_MAGIC, 4) != 0 || ReadU32(data + 4) != BATCH_VERSION) {
+        return 0;
+    }
+    size_t offset = 8;
+    while (offset < len) {
+        if (offset + 5 > len) {
+            return 0;
+        }
+        uint8_t kind = data[offset];
+        uint32_t payload_len = ReadU32(data + offset + 1);
+        if (payload_len > len - offset - 5) {
+            return 0;
+        }
+        BatchReader reader = {data + offset + 5, payload_len, 0, 1};
+        offset += 5 + payload_len;
+
+        switch (kind) {
+            case BATCH_STRING_ID_ENTRY: {
+                size_t icon_len;
+                char* cred_id = BatchGetString(&reader);
+                char* icon = BatchGetIcon(&reader, &icon_len);
+                char* title = BatchGetString(&reader);
+                char* subtitle = BatchGetString(&reader);
+                char* disclaimer = BatchGetString(&reader);
+                char* warning = BatchGetString(&reader);
+                if (reader.ok) {
+                    AddStringIdEntry(cred_id, icon, icon_len, title, subtitle, disclaimer, warning);
+                }
+                break;
+            }
+            case BATCH_FIELD: {
+                char* cred_id = BatchGetString(&reader);
+                char* field_display_name = BatchGetString(&reader);
+                char* field_display_value = BatchGetString(&reader);
+                if (reader.ok) {
+                    AddFieldForStringIdEntry(cred_id, field_display_name, field_display_value);
+                }
+                break;
+            }
+            case BATCH_PAYMENT_ENTRY: {
+                size_t payment_method_icon_len, bank_icon_len, payment_provider_icon_len;
+                char* cred_id = BatchGetString(&reader);
+                char* merchant_name = BatchGetString(&reader);
+                char* payment_method_name = BatchGetString(&reader);
+                char* payment_method_subtitle = BatchGetString(&reader);
+                char* payment_method_icon = BatchGetIcon(&reader, &payment_method_icon_len);
+                char* transaction_amount = BatchGetString(&reader);
+                char* bank_icon = BatchGetIcon(&reader, &bank_icon_len);
+                char* payment_provider_icon = BatchGetIcon(&reader, &payment_provider_icon_len);
+                if (reader.ok) {
+                    AddPaymentEntry(cred_id, merchant_name, payment_method_name, payment_method_subtitle, payment_method_icon, payment_method_icon_len, transaction_amount, bank_icon, bank_icon_len, payment_provider_icon, payment_provider_icon_len);
+                }
+                break;
+            }
+            case BATCH_VERIFICATION_DISCLAIMER: {
+                char* cred_id = BatchGetString(&reader);
+                char* secondary_disclaimer = BatchGetString(&reader);
+                char* url_display_text = BatchGetString(&reader);
+                char* url_value = BatchGetString(&reader);
+                if (reader.ok) {
+                    SetAdditionalDisclaimerAndUrlForVerificationEntry(cred_id, secondary_disclaimer, url_display_text, url_value);
+                }
+                break;
+            }
+            default:
+                // Calls added by a later version are skipped.
+                break;
+        }
+        if (!reader.ok) {
+            return 0;
+        }
+    }
+    return 1;
+}
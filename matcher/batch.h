@@ -0,0 +1,46 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Batched emission, build the matcher with -DCREDMAN_BATCH to collect the emitted entries and
+// fields in one buffer that is handed to the host with a single AddEntriesBatch call when the
+// matcher exits. Hosts that don't take the batch get the same calls one by one.
+//
+// |---------------------------------------|
+// |------ "CMEB", (u32) version ----------|
+// |--- (u8) kind, (u32) payload length ---|
+// |---- payload: the call arguments ------|
+// |------------- More calls... -----------|
+// |---------------------------------------|
+//
+// All integers are little endian. Arguments are written in the order of the per-entry import.
+// Strings are a u32 length followed by the bytes and a NUL terminator, so that they can be used
+// in place. A NULL string has the length 0xffffffff and no bytes. Icons are a u32 length followed
+// by the bytes.
+
+#define BATCH_MAGIC "CMEB"
+#define BATCH_VERSION 1
+#define BATCH_NULL_STRING 0xffffffffu
+
+enum BatchKind {
+    BATCH_STRING_ID_ENTRY = 1,          // AddStringIdEntry
+    BATCH_FIELD = 2,                    // AddFieldForStringIdEntry
+    BATCH_PAYMENT_ENTRY = 3,            // AddPaymentEntry
+    BATCH_VERIFICATION_DISCLAIMER = 4   // SetAdditionalDisclaimerAndUrlForVerificationEntry
+};
+
+void BatchAddStringIdEntry(char *cred_id, char* icon, size_t icon_len, char *title, char *subtitle, char *disclaimer, char *warning);
+void BatchAddFieldForStringIdEntry(char *cred_id, char *field_display_name, char *field_display_value);
+void BatchAddPaymentEntry(char *cred_id, char *merchant_name, char *payment_method_name, char *payment_method_subtitle, char* payment_method_icon, size_t payment_method_icon_len, char *transaction_amount, char* bank_icon, size_t bank_icon_len, char* payment_provider_icon, size_t payment_provider_icon_len);
+void BatchSetAdditionalDisclaimerAndUrlForVerificationEntry(char *cred_id, char *secondary_disclaimer, char *url_display_text, char *url_value);
+
+// Hands the collected calls to the host, registered with atexit on the first call.
+void BatchFlush(void);
+
+// Decodes a batch and makes each call through the per-entry imports. Returns 0 if the batch is
+// malformed, calls decoded before the error have been made.
+int BatchEmit(const uint8_t* data, size_t len);
+
+#endif
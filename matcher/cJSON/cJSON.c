@@ -23,6 +23,11 @@
 /* cJSON */
 /* JSON parser in C. */
 
+/* Optional feature macros for builds that only need part of the library:
+ * CJSON_NO_PRINT      removes cJSON_Print* together with the number formatting it pulls in
+ * CJSON_NO_DUPLICATE  removes cJSON_Duplicate
+ * CJSON_NO_MINIFY     removes cJSON_Minify */
+
 /* disable warnings about old C89 functions in MSVC */
 #if !defined(_CRT_SECURE_NO_DEPRECATE) && defined(_MSC_VER)
 #define _CRT_SECURE_NO_DEPRECATE
@@ -424,6 +429,7 @@ CJSON_PUBLIC(char*) cJSON_SetValuestring(cJSON *object, const char *valuestring)
     return copy;
 }
 
+#if !defined(CJSON_NO_PRINT)
 typedef struct
 {
     unsigned char *buffer;
@@ -534,6 +540,8 @@ static void update_offset(printbuffer * const buffer)
     buffer->offset += strlen((const char*)buffer_pointer);
 }
 
+#endif /* !CJSON_NO_PRINT */
+
 /* securely comparison of floating-point variables */
 static cJSON_bool compare_double(double a, double b)
 {
@@ -541,6 +549,7 @@ static cJSON_bool compare_double(double a, double b)
     return (fabs(a - b) <= maxVal * DBL_EPSILON);
 }
 
+#if !defined(CJSON_NO_PRINT)
 /* Render the number nicely from the given item into a string. */
 static cJSON_bool print_number(const cJSON * const item, printbuffer * const output_buffer)
 {
@@ -611,6 +620,8 @@ static cJSON_bool print_number(const cJSON * const item, printbuffer * const out
     return true;
 }
 
+#endif /* !CJSON_NO_PRINT */
+
 /* parse 4 digit hexadecimal number */
 static unsigned parse_hex4(const unsigned char * const input)
 {
@@ -898,6 +909,7 @@ fail:
     return false;
 }
 
+#if !defined(CJSON_NO_PRINT)
 /* Render the cstring provided to an escaped version that can be printed. */
 static cJSON_bool print_string_ptr(const unsigned char * const input, printbuffer * const output_buffer)
 {
@@ -1026,13 +1038,17 @@ static cJSON_bool print_string(const cJSON * const item, printbuffer * const p)
     return print_string_ptr((unsigned char*)item->valuestring, p);
 }
 
+#endif /* !CJSON_NO_PRINT */
+
 /* Predeclare these prototypes. */
 static cJSON_bool parse_value(cJSON * const item, parse_buffer * const input_buffer);
-static cJSON_bool print_value(const cJSON * const item, printbuffer * const output_buffer);
 static cJSON_bool parse_array(cJSON * const item, parse_buffer * const input_buffer);
-static cJSON_bool print_array(const cJSON * const item, printbuffer * const output_buffer);
 static cJSON_bool parse_object(cJSON * const item, parse_buffer * const input_buffer);
+#if !defined(CJSON_NO_PRINT)
+static cJSON_bool print_value(const cJSON * const item, printbuffer * const output_buffer);
+static cJSON_bool print_array(const cJSON * const item, printbuffer * const output_buffer);
 static cJSON_bool print_object(const cJSON * const item, printbuffer * const output_buffer);
+#endif
 
 /* Utility to jump whitespace and cr/lf */
 static parse_buffer *buffer_skip_whitespace(parse_buffer * const buffer)
@@ -1182,6 +1198,7 @@ CJSON_PUBLIC(cJSON *) cJSON_ParseWithLength(const char *value, size_t buffer_len
     return cJSON_ParseWithLengthOpts(value, buffer_length, 0, 0);
 }
 
+#if !defined(CJSON_NO_PRINT)
 #define cjson_min(a, b) (((a) < (b)) ? (a) : (b))
 
 static unsigned char *print(const cJSON * const item, cJSON_bool format, const internal_hooks * const hooks)
@@ -1308,6 +1325,8 @@ CJSON_PUBLIC(cJSON_bool) cJSON_PrintPreallocated(cJSON *item, char *buffer, cons
     return print_value(item, &p);
 }
 
+#endif /* !CJSON_NO_PRINT */
+
 /* Parser core - when encountering text, process appropriately. */
 static cJSON_bool parse_value(cJSON * const item, parse_buffer * const input_buffer)
 {
@@ -1363,6 +1382,7 @@ static cJSON_bool parse_value(cJSON * const item, parse_buffer * const input_buf
     return false;
 }
 
+#if !defined(CJSON_NO_PRINT)
 /* Render a value to text. */
 static cJSON_bool print_value(const cJSON * const item, printbuffer * const output_buffer)
 {
@@ -1437,6 +1457,8 @@ static cJSON_bool print_value(const cJSON * const item, printbuffer * const outp
     }
 }
 
+#endif /* !CJSON_NO_PRINT */
+
 /* Build an array from input text. */
 static cJSON_bool parse_array(cJSON * const item, parse_buffer * const input_buffer)
 {
@@ -1535,6 +1557,7 @@ fail:
     return false;
 }
 
+#if !defined(CJSON_NO_PRINT)
 /* Render an array to text */
 static cJSON_bool print_array(const cJSON * const item, printbuffer * const output_buffer)
 {
@@ -1597,6 +1620,8 @@ static cJSON_bool print_array(const cJSON * const item, printbuffer * const outp
     return true;
 }
 
+#endif /* !CJSON_NO_PRINT */
+
 /* Build an object from the text. */
 static cJSON_bool parse_object(cJSON * const item, parse_buffer * const input_buffer)
 {
@@ -1710,6 +1735,7 @@ fail:
     return false;
 }
 
+#if !defined(CJSON_NO_PRINT)
 /* Render an object to text. */
 static cJSON_bool print_object(const cJSON * const item, printbuffer * const output_buffer)
 {
@@ -1824,6 +1850,8 @@ static cJSON_bool print_object(const cJSON * const item, printbuffer * const out
     return true;
 }
 
+#endif /* !CJSON_NO_PRINT */
+
 /* Get Array size/item / object item. */
 CJSON_PUBLIC(int) cJSON_GetArraySize(const cJSON *array)
 {
@@ -2702,6 +2730,7 @@ CJSON_PUBLIC(cJSON *) cJSON_CreateStringArray(const char *const *strings, int co
     return a;
 }
 
+#if !defined(CJSON_NO_DUPLICATE)
 /* Duplication */
 CJSON_PUBLIC(cJSON *) cJSON_Duplicate(const cJSON *item, cJSON_bool recurse)
 {
@@ -2786,6 +2815,9 @@ fail:
     return NULL;
 }
 
+#endif /* !CJSON_NO_DUPLICATE */
+
+#if !defined(CJSON_NO_MINIFY)
 static void skip_oneline_comment(char **input)
 {
     *input += static_strlen("//");
@@ -2883,6 +2915,8 @@ CJSON_PUBLIC(void) cJSON_Minify(char *json)
     *into = '\0';
 }
 
+#endif /* !CJSON_NO_MINIFY */
+
 CJSON_PUBLIC(cJSON_bool) cJSON_IsInvalid(const cJSON * const item)
 {
     if (item == NULL)
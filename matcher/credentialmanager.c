@@ -1,3 +1,4 @@
+#define CREDMAN_HOST_IMPL
 #include "credentialmanager.h"
 
 void* GetRequest() {
@@ -14,4 +15,109 @@ void* GetCredentials() {
 	void* buffer = malloc(size);
 	ReadCredentialsBuffer(buffer, 0, size);
 	return buffer;
-}
\ No newline at end of file
+}
+
+#if defined(CREDMAN_TRACE)
+#include <stdio.h>
+#include <string.h>
+
+#include "base64.h"
+#include "trace.h"
+
+// The recorded calls still go out through the batch in batch mode.
+#if defined(CREDMAN_BATCH)
+#include "batch.h"
+#define EmitStringIdEntry BatchAddStringIdEntry
+#define EmitFieldForStringIdEntry BatchAddFieldForStringIdEntry
+#define EmitPaymentEntry BatchAddPaymentEntry
+#define EmitVerificationDisclaimer BatchSetAdditionalDisclaimerAndUrlForVerificationEntry
+#else
+#define EmitStringIdEntry AddStringIdEntry
+#define EmitFieldForStringIdEntry AddFieldForStringIdEntry
+#define EmitPaymentEntry AddPaymentEntry
+#define EmitVerificationDisclaimer SetAdditionalDisclaimerAndUrlForVerificationEntry
+#endif
+
+#ifndef CREDMAN_TRACE_PATH
+#define CREDMAN_TRACE_PATH "credman.trace"
+#endif
+
+static TraceBuffer trace;
+
+// Writes the trace to CREDMAN_TRACE_PATH. Runtimes without a writable file system get it on
+// stdout instead, base64url encoded on a single "CREDMAN_TRACE" line that testharness.c also accepts.
+static void TraceFlush(void) {
+	FILE* f = fopen(CREDMAN_TRACE_PATH, "wb");
+	if (f != NULL) {
+		fwrite(trace.data, 1, trace.len, f);
+		fclose(f);
+		return;
+	}
+	char* encoded;
+	B64EncodeURL(trace.data, trace.len, &encoded);
+	printf("CREDMAN_TRACE %s\n", encoded);
+	free(encoded);
+}
+
+static TraceBuffer* Trace() {
+	if (trace.data == NULL) {
+		TraceBegin(&trace);
+		atexit(TraceFlush);
+	}
+	return &trace;
+}
+
+void TraceGetRequestBuffer(void* buffer) {
+	uint32_t size;
+	GetRequestSize(&size);
+	GetRequestBuffer(buffer);
+	size_t record = TraceBeginRecord(Trace(), TRACE_REQUEST);
+	TracePutBytes(Trace(), buffer, size);
+	TraceEndRecord(Trace(), record);
+}
+
+size_t TraceReadCredentialsBuffer(void* buffer, size_t offset, size_t len) {
+	size_t bytes_read = ReadCredentialsBuffer(buffer, offset, len);
+	size_t record = TraceBeginRecord(Trace(), TRACE_CREDENTIALS_READ);
+	TracePutU32(Trace(), offset);
+	TracePutU32(Trace(), len);
+	TracePutBytes(Trace(), buffer, bytes_read);
+	TraceEndRecord(Trace(), record);
+	return bytes_read;
+}
+
+void TraceGetCredentialsSize(uint32_t* size) {
+	GetCredentialsSize(size);
+	size_t record = TraceBeginRecord(Trace(), TRACE_CREDENTIALS_SIZE);
+	TracePutU32(Trace(), *size);
+	TraceEndRecord(Trace(), record);
+}
+
+void TraceGetCallingAppInfo(CallingAppInfo* info) {
+	GetCallingAppInfo(info);
+	size_t record = TraceBeginRecord(Trace(), TRACE_CALLING_APP_INFO);
+	TracePutBytes(Trace(), info->package_name, strnlen(info->package_name, sizeof(info->package_name)));
+	TracePutBytes(Trace(), info->origin, strnlen(info->origin, sizeof(info->origin)));
+	TraceEndRecord(Trace(), record);
+}
+
+void TraceAddStringIdEntry(char *cred_id, char* icon, size_t icon_len, char *title, char *subtitle, char *disclaimer, char *warning) {
+	TraceStringIdEntry(Trace(), cred_id, icon, icon_len, title, subtitle, disclaimer, warning);
+	EmitStringIdEntry(cred_id, icon, icon_len, title, subtitle, disclaimer, warning);
+}
+
+void TraceAddFieldForStringIdEntry(char *cred_id, char *field_display_name, char *field_display_value) {
+	TraceField(Trace(), cred_id, field_display_name, field_display_value);
+	EmitFieldForStringIdEntry(cred_id, field_display_name, field_display_value);
+}
+
+void TraceAddPaymentEntry(char *cred_id, char *merchant_name, char *payment_method_name, char *payment_method_subtitle, char* payment_method_icon, size_t payment_method_icon_len, char *transaction_amount, char* bank_icon, size_t bank_icon_len, char* payment_provider_icon, size_t payment_provider_icon_len) {
+	TracePaymentEntry(Trace(), cred_id, merchant_name, payment_method_name, payment_method_subtitle, payment_method_icon, payment_method_icon_len, transaction_amount, bank_icon, bank_icon_len, payment_provider_icon, payment_provider_icon_len);
+	EmitPaymentEntry(cred_id, merchant_name, payment_method_name, payment_method_subtitle, payment_method_icon, payment_method_icon_len, transaction_amount, bank_icon, bank_icon_len, payment_provider_icon, payment_provider_icon_len);
+}
+
+void TraceSetAdditionalDisclaimerAndUrlForVerificationEntry(char *cred_id, char *secondary_disclaimer, char *url_display_text, char *url_value) {
+	TraceVerificationDisclaimer(Trace(), cred_id, secondary_disclaimer, url_display_text, url_value);
+	EmitVerificationDisclaimer(cred_id, secondary_disclaimer, url_display_text, url_value);
+}
+#endif
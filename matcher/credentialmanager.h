@@ -56,6 +56,13 @@ __attribute__((import_module("credman"), import_name("SetAdditionalDisclaimerAnd
 #endif
 void SetAdditionalDisclaimerAndUrlForVerificationEntry(char *cred_id, char *secondary_disclaimer, char *url_display_text, char *url_value);
 
+// Emits a batch of entries and fields in one call, see batch.h for the layout. Returns 0 if the
+// host did not take the batch, the matcher then makes the calls one by one.
+#if defined(__wasm__)
+__attribute__((import_module("credman"), import_name("AddEntriesBatch")))
+#endif
+int32_t AddEntriesBatch(const void* buffer, size_t len);
+
 typedef struct CallingAppInfo {
 	char package_name[256];
 	char origin[512];
@@ -66,4 +73,39 @@ __attribute__((import_module("credman"), import_name("GetCallingAppInfo")))
 #endif
 void GetCallingAppInfo(CallingAppInfo* info);
 
-#endif 
+// Capture mode, build the matcher with -DCREDMAN_TRACE to record every host call into a trace
+// that testharness.c can replay (see trace.h). The wrappers live in credentialmanager.c,
+// translation units implementing or wrapping the host calls define CREDMAN_HOST_IMPL first.
+#if defined(CREDMAN_TRACE)
+void TraceGetRequestBuffer(void* buffer);
+size_t TraceReadCredentialsBuffer(void* buffer, size_t offset, size_t len);
+void TraceGetCredentialsSize(uint32_t* size);
+void TraceGetCallingAppInfo(CallingAppInfo* info);
+void TraceAddStringIdEntry(char *cred_id, char* icon, size_t icon_len, char *title, char *subtitle, char *disclaimer, char *warning);
+void TraceAddFieldForStringIdEntry(char *cred_id, char *field_display_name, char *field_display_value);
+void TraceAddPaymentEntry(char *cred_id, char *merchant_name, char *payment_method_name, char *payment_method_subtitle, char* payment_method_icon, size_t payment_method_icon_len, char *transaction_amount, char* bank_icon, size_t bank_icon_len, char* payment_provider_icon, size_t payment_provider_icon_len);
+void TraceSetAdditionalDisclaimerAndUrlForVerificationEntry(char *cred_id, char *secondary_disclaimer, char *url_display_text, char *url_value);
+
+#if !defined(CREDMAN_HOST_IMPL)
+#define GetRequestBuffer TraceGetRequestBuffer
+#define ReadCredentialsBuffer TraceReadCredentialsBuffer
+#define GetCredentialsSize TraceGetCredentialsSize
+#define GetCallingAppInfo TraceGetCallingAppInfo
+#define AddStringIdEntry TraceAddStringIdEntry
+#define AddFieldForStringIdEntry TraceAddFieldForStringIdEntry
+#define AddPaymentEntry TraceAddPaymentEntry
+#define SetAdditionalDisclaimerAndUrlForVerificationEntry TraceSetAdditionalDisclaimerAndUrlForVerificationEntry
+#endif
+#endif
+
+// Batch mode, build the matcher with -DCREDMAN_BATCH to emit all entries and fields with one
+// AddEntriesBatch call (see batch.h). In capture mode the trace wrappers forward to the batch.
+#if defined(CREDMAN_BATCH) && !defined(CREDMAN_TRACE) && !defined(CREDMAN_HOST_IMPL)
+#include "batch.h"
+#define AddStringIdEntry BatchAddStringIdEntry
+#define AddFieldForStringIdEntry BatchAddFieldForStringIdEntry
+#define AddPaymentEntry BatchAddPaymentEntry
+#define SetAdditionalDisclaimerAndUrlForVerificationEntry BatchSetAdditionalDisclaimerAndUrlForVerificationEntry
+#endif
+
+#endif
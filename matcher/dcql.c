@@ -1,196 +1,445 @@
+#include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "dcql.h"
+#include "hash.h"
+#include "path_filter.h"
 
 #include "cJSON/cJSON.h"
 
-int AddAllClaims(cJSON* matched_claim_names, cJSON* candidate_paths) {
-    cJSON* curr_path;
-    cJSON_ArrayForEach(curr_path, candidate_paths) {
-        cJSON* attr;
-        if (cJSON_HasObjectItem(curr_path, "display")) {
-            cJSON_AddItemReferenceToArray(matched_claim_names, cJSON_GetObjectItem(curr_path, "display"));
-        } else if (cJSON_IsObject(curr_path)) {
+int AddAllClaims(cJSON* matched_claim_names, StoreRef candidate_paths) {
+    StoreRef curr_path;
+    StoreArrayForEach(curr_path, candidate_paths) {
+        if (StoreHasObjectItem(curr_path, "display")) {
+            StoreAddItemToArray(matched_claim_names, StoreGetObjectItem(curr_path, "display"));
+        } else if (StoreIsObject(curr_path)) {
             AddAllClaims(matched_claim_names, curr_path);
         }
     }
     return 0;
 }
 
-cJSON* MatchCredential(cJSON* credential, cJSON* credential_store) {
-    cJSON* matched_credentials = cJSON_CreateArray();
-    char* format = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(credential, "format"));
+// Most nulls in a claim path, paths with more never resolve.
+#define PATH_MAX_FAN_OUTS 16
 
-    // check for optional params
-    cJSON* meta = cJSON_GetObjectItemCaseSensitive(credential, "meta");
-    cJSON* claims = cJSON_GetObjectItemCaseSensitive(credential, "claims");
-    cJSON* claim_sets = cJSON_GetObjectItemCaseSensitive(credential, "claim_sets");
+// A claim of a credential query, with what every candidate looks up taken out of it once.
+typedef struct QueryClaim {
+    const char* id;
+    cJSON* path;
+    cJSON* values;
+    int resolvable; // 0 for paths with components other than keys, nulls and indices
+    const char* namespace; // mdoc paths, NULL unless the path is two strings
+    const char* element;
+} QueryClaim;
 
-    cJSON* candidates = cJSON_GetObjectItemCaseSensitive(credential_store, format);
+// A credential query as its candidates are matched against it, and where the matches go.
+typedef struct CandidateQuery {
+    cJSON* claims;
+    cJSON* claim_sets;
+    QueryClaim* query_claims; // when there are claims
+    int claims_size;
+    ClaimPlan plan; // when there are claims
+    char* trusted_authorities; // hash list, NULL when any authority is trusted
+    size_t trusted_authorities_len;
+    cJSON* matched_credentials;
+    int matched; // size of matched_credentials
+} CandidateQuery;
 
-    if (candidates == NULL) {
-        return matched_credentials;
+static void AddMatchedCredential(CandidateQuery* query, cJSON* matched_credential) {
+    cJSON_AddItemReferenceToArray(query->matched_credentials, matched_credential);
+    query->matched++;
+}
+
+// A doctype or vct array of candidates, and the next one to visit.
+typedef struct CandidateList {
+    StoreRef candidates;
+    StoreRef next;
+    double priority; // of next
+} CandidateList;
+
+static void AdvanceCandidateList(CandidateList* list, StoreRef next) {
+    list->next = next;
+    StoreRef priority = StoreGetObjectItemCaseSensitive(next, "priority");
+    list->priority = StoreIsNumber(priority) ? StoreGetNumberValue(priority) : 0;
+}
+
+// Returns the candidate with the highest "priority" next in any of the lists, ties going to the
+// earlier list, and moves past it. The registry writer sorts each list by descending priority,
+// so this visits the candidates of all of them in that order, and in list order without any.
+static StoreRef NextCandidate(CandidateList* lists, int lists_size) {
+    if (lists_size == 1) {
+        // A single list is already in order
+        StoreRef candidate = lists->next;
+        if (candidate != NULL) {
+            lists->next = StoreNextChild(lists->candidates, candidate);
+        }
+        return candidate;
     }
+    CandidateList* best = NULL;
+    for (int i = 0; i < lists_size; i++) {
+        if (lists[i].next != NULL && (best == NULL || lists[i].priority > best->priority)) {
+            best = &lists[i];
+        }
+    }
+    if (best == NULL) {
+        return NULL;
+    }
+    StoreRef candidate = best->next;
+    AdvanceCandidateList(best, StoreNextChild(best->candidates, candidate));
+    return candidate;
+}
 
-    // Filter by meta
-    if (meta != NULL) {
-        if (strcmp(format, "mso_mdoc") == 0) {
-            cJSON* doctype_value_obj = cJSON_GetObjectItemCaseSensitive(meta, "doctype_value");
-            if (doctype_value_obj != NULL) {
-                char* doctype_value = cJSON_GetStringValue(doctype_value_obj);
-                candidates = cJSON_GetObjectItemCaseSensitive(candidates, doctype_value);
-                //printf("candidates %s\n", cJSON_Print(candidates));
+static int CompareHashes(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// The trusted_authorities of a credential query as a hash list, see hash.h, of "<type>:<value>"
+// for each of their values. NULL when there are none.
+static char* CompileTrustedAuthorities(cJSON* trusted_authorities) {
+    int count = 0;
+    cJSON* authority;
+    cJSON_ArrayForEach(authority, trusted_authorities) {
+        count += cJSON_GetArraySize(cJSON_GetObjectItemCaseSensitive(authority, "values"));
+    }
+    if (count == 0) {
+        return NULL;
+    }
+    uint32_t* hashes = malloc(sizeof(uint32_t) * count);
+    int size = 0;
+    cJSON_ArrayForEach(authority, trusted_authorities) {
+        char* type = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(authority, "type"));
+        cJSON* value;
+        cJSON_ArrayForEach(value, cJSON_GetObjectItemCaseSensitive(authority, "values")) {
+            if (type == NULL || !cJSON_IsString(value)) {
+                continue;
             }
-        } else if (strcmp(format, "dc+sd-jwt") == 0) {
-            cJSON* vct_values_obj = cJSON_GetObjectItemCaseSensitive(meta, "vct_values");
-            cJSON* cred_candidates = candidates;
-            candidates = cJSON_CreateArray();
-            cJSON* vct_value;
-            cJSON_ArrayForEach(vct_value, vct_values_obj) {
-                cJSON* vct_candidates = cJSON_GetObjectItemCaseSensitive(cred_candidates, cJSON_GetStringValue(vct_value));
-                cJSON* curr_candidate;
-                cJSON_ArrayForEach(curr_candidate, vct_candidates) {
-                    cJSON_AddItemReferenceToArray(candidates, curr_candidate);
-                }
+            size_t type_len = strlen(type);
+            size_t value_len = strlen(cJSON_GetStringValue(value));
+            char* key = malloc(type_len + value_len + 1);
+            memcpy(key, type, type_len);
+            key[type_len] = ':';
+            memcpy(key + type_len + 1, cJSON_GetStringValue(value), value_len);
+            hashes[size++] = HashBytes(key, type_len + value_len + 1);
+            free(key);
+        }
+    }
+    qsort(hashes, size, sizeof(uint32_t), CompareHashes);
+    char* list = malloc(size * HASH_HEX_LEN + 1);
+    for (int i = 0; i < size; i++) {
+        HashToHex(hashes[i], list + i * HASH_HEX_LEN);
+    }
+    list[size * HASH_HEX_LEN] = '\0';
+    free(hashes);
+    return list;
+}
+
+// Whether the candidate was issued by one of the trusted authorities of the query. The registry
+// lists the authorities of a credential as its "authority_hashes", a hash list like the query's,
+// so this is a binary search per authority of the candidate. Candidates registered without the
+// list may have been issued by any authority.
+static int AuthorityTrusted(const CandidateQuery* query, StoreRef candidate) {
+    if (query->trusted_authorities == NULL) {
+        return 1;
+    }
+    const char* hashes = StoreGetStringValue(StoreGetObjectItemCaseSensitive(candidate, "authority_hashes"));
+    if (hashes == NULL) {
+        return 1;
+    }
+    size_t len = strlen(hashes);
+    for (size_t i = 0; i + HASH_HEX_LEN <= len; i += HASH_HEX_LEN) {
+        if (HashListFind(query->trusted_authorities, query->trusted_authorities_len, hashes + i) >= 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int PathResolvable(cJSON* path) {
+    int fan_outs = 0;
+    cJSON* component;
+    cJSON_ArrayForEach(component, path) {
+        if (cJSON_IsNull(component)) {
+            fan_outs++;
+        } else if (cJSON_IsNumber(component)) {
+            double index = cJSON_GetNumberValue(component);
+            if (!(index >= 0 && index <= INT_MAX && index == (int)index)) {
+                return 0;
             }
-        } else  {
-            return matched_credentials;
+        } else if (!cJSON_IsString(component)) {
+            return 0;
         }
     }
+    return cJSON_IsArray(path) && fan_outs <= PATH_MAX_FAN_OUTS;
+}
 
-    if (candidates == NULL) {
-        return matched_credentials;
+static void CompileClaims(CandidateQuery* query) {
+    query->claims_size = cJSON_GetArraySize(query->claims);
+    query->query_claims = calloc(query->claims_size > 0 ? query->claims_size : 1, sizeof(QueryClaim));
+    QueryClaim* query_claim = query->query_claims;
+    cJSON* claim;
+    cJSON_ArrayForEach(claim, query->claims) {
+        query_claim->id = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(claim, "id"));
+        query_claim->path = cJSON_GetObjectItemCaseSensitive(claim, "path");
+        query_claim->values = cJSON_GetObjectItemCaseSensitive(claim, "values");
+        query_claim->resolvable = PathResolvable(query_claim->path);
+        if (cJSON_GetArraySize(query_claim->path) == 2) {
+            query_claim->namespace = cJSON_GetStringValue(cJSON_GetArrayItem(query_claim->path, 0));
+            query_claim->element = cJSON_GetStringValue(cJSON_GetArrayItem(query_claim->path, 1));
+        }
+        query_claim++;
     }
+}
 
-    // Match on the claims
-    if (claims == NULL) {
-        // Match every candidate
-        cJSON* candidate;
-        cJSON_ArrayForEach(candidate, candidates) {
-            cJSON* matched_credential = cJSON_CreateObject();
-            cJSON_AddItemReferenceToObject(matched_credential, "id", cJSON_GetObjectItemCaseSensitive(candidate, "id"));
-            cJSON_AddItemReferenceToObject(matched_credential, "title", cJSON_GetObjectItemCaseSensitive(candidate, "title"));
-            cJSON_AddItemReferenceToObject(matched_credential, "subtitle", cJSON_GetObjectItemCaseSensitive(candidate, "subtitle"));
-            cJSON_AddItemReferenceToObject(matched_credential, "icon", cJSON_GetObjectItemCaseSensitive(candidate, "icon"));
-            cJSON* matched_claim_names = cJSON_CreateArray();
-            //printf("candidate %s\n", cJSON_Print(candidate));
-            AddAllClaims(matched_claim_names, cJSON_GetObjectItemCaseSensitive(candidate, "paths"));
-            cJSON_AddItemReferenceToObject(matched_credential, "matched_claim_names", matched_claim_names);
-            cJSON_AddItemReferenceToArray(matched_credentials, matched_credential);
+// Returns the display of the resolved claim if it holds one of the requested values, NULL
+// otherwise.
+static StoreRef MatchClaim(StoreRef claim_entry, const QueryClaim* claim) {
+    StoreRef display = StoreGetObjectItem(claim_entry, "display");
+    if (display == NULL || claim->values == NULL) {
+        return display;
+    }
+    StoreRef value = StoreGetObjectItemCaseSensitive(claim_entry, "value");
+    cJSON* v;
+    cJSON_ArrayForEach(v, claim->values) {
+        if (StoreCompare(v, value)) {
+            return display;
         }
-    } else {
-        if (claim_sets == NULL) {
-            cJSON* candidate;
-            cJSON_ArrayForEach(candidate, candidates) {
-                cJSON* matched_credential = cJSON_CreateObject();
-                cJSON_AddItemReferenceToObject(matched_credential, "id", cJSON_GetObjectItemCaseSensitive(candidate, "id"));
-                cJSON_AddItemReferenceToObject(matched_credential, "title", cJSON_GetObjectItemCaseSensitive(candidate, "title"));
-                cJSON_AddItemReferenceToObject(matched_credential, "subtitle", cJSON_GetObjectItemCaseSensitive(candidate, "subtitle"));
-                cJSON_AddItemReferenceToObject(matched_credential, "icon", cJSON_GetObjectItemCaseSensitive(candidate, "icon"));
-                cJSON* matched_claim_names = cJSON_CreateArray();
+    }
+    return NULL;
+}
 
-                cJSON* claim;
-                cJSON* candidate_claims = cJSON_GetObjectItemCaseSensitive(candidate, "paths");
-                cJSON_ArrayForEach(claim, claims) {
-                    cJSON* claim_values = cJSON_GetObjectItemCaseSensitive(claim, "values");
-                    cJSON* paths = cJSON_GetObjectItemCaseSensitive(claim, "path");
-                    cJSON* curr_path;
-                    cJSON* curr_claim = candidate_claims;
-                    int matched = 1;
-                    cJSON_ArrayForEach(curr_path, paths) {
-                        char* path_value = cJSON_GetStringValue(curr_path);
-                        if (cJSON_HasObjectItem(curr_claim, path_value)) {
-                            curr_claim = cJSON_GetObjectItemCaseSensitive(curr_claim, path_value);
-                        } else {
-                            matched = 0;
-                            break;
-                        }
-                    }
-                    if (matched != 0 && curr_claim != NULL && cJSON_HasObjectItem(curr_claim, "display")) {
-                        if (claim_values != NULL) {
-                            cJSON* v;
-                            cJSON_ArrayForEach(v, claim_values) {
-                                if (cJSON_Compare(v, cJSON_GetObjectItemCaseSensitive(curr_claim, "value"), cJSON_True)) {
-                                    cJSON_AddItemReferenceToArray(matched_claim_names, cJSON_GetObjectItem(curr_claim, "display"));
-                                    break;
-                                }
-                            }
-                        } else {
-                            cJSON_AddItemReferenceToArray(matched_claim_names, cJSON_GetObjectItem(curr_claim, "display"));
-                        }
+// The kernels return the display of the first entry the path of a claim resolves to under the
+// "paths" of a candidate that matches the claim, NULL if there is none. mdoc paths are always a
+// namespace and an element, so that is two lookups.
+static inline StoreRef MatchMdocClaim(StoreRef candidate_claims, const QueryClaim* claim) {
+    if (claim->namespace == NULL || claim->element == NULL) {
+        return NULL;
+    }
+    return MatchClaim(StoreGetObjectItemCaseSensitive(StoreGetObjectItemCaseSensitive(candidate_claims, claim->namespace), claim->element), claim);
+}
+
+// A null of an sd-jwt path whose elements are being visited.
+typedef struct PathFanOut {
+    StoreRef elements;
+    StoreRef element;
+    cJSON* rest; // the path after the null
+} PathFanOut;
+
+// sd-jwt paths go through objects and arrays nested to any depth. The registry writes an array
+// claim as an entry like any other, its "value" being the whole array, with the entries of its
+// elements in an "elements" array. An index selects one of them and a null each in turn: the
+// walk goes on with the first, and comes back to the next whenever the rest of the path fails,
+// the fan outs being kept on a stack as deep as there are nulls in the path.
+static inline StoreRef MatchSdJwtClaim(StoreRef candidate_claims, const QueryClaim* claim) {
+    if (!claim->resolvable) {
+        return NULL;
+    }
+    PathFanOut fan_outs[PATH_MAX_FAN_OUTS];
+    int depth = 0;
+    StoreRef curr_claim = candidate_claims;
+    cJSON* curr_path = claim->path->child;
+    for (;;) {
+        while (curr_claim != NULL && curr_path != NULL) {
+            if (cJSON_IsString(curr_path)) {
+                curr_claim = StoreGetObjectItemCaseSensitive(curr_claim, cJSON_GetStringValue(curr_path));
+            } else {
+                StoreRef elements = StoreGetObjectItemCaseSensitive(curr_claim, "elements");
+                if (!StoreIsArray(elements)) {
+                    curr_claim = NULL;
+                } else if (cJSON_IsNumber(curr_path)) {
+                    curr_claim = StoreGetArrayItem(elements, (int)cJSON_GetNumberValue(curr_path));
+                } else {
+                    curr_claim = StoreFirstChild(elements);
+                    if (curr_claim != NULL) {
+                        fan_outs[depth++] = (PathFanOut){ elements, curr_claim, curr_path->next };
                     }
                 }
+            }
+            curr_path = curr_path->next;
+        }
+        if (curr_claim != NULL) {
+            StoreRef display = MatchClaim(curr_claim, claim);
+            if (display != NULL) {
+                return display;
+            }
+        }
+        // Go on with the next element of the innermost null that has one left
+        while (depth > 0 && (fan_outs[depth - 1].element = StoreNextChild(fan_outs[depth - 1].elements, fan_outs[depth - 1].element)) == NULL) {
+            depth--;
+        }
+        if (depth == 0) {
+            return NULL;
+        }
+        curr_claim = fan_outs[depth - 1].element;
+        curr_path = fan_outs[depth - 1].rest;
+    }
+}
+
+typedef StoreRef (*MatchPath)(StoreRef candidate_claims, const QueryClaim* claim);
+
+// Adds the candidates of the lists that satisfy the claims of the credential query, in the order
+// of NextCandidate and up to MATCHER_ENTRY_LIMIT of them. Only called from
+// DEFINE_MATCH_CANDIDATES, so each kernel gets a copy with its claim matching inlined.
+static inline __attribute__((always_inline)) void MatchCandidatesWith(MatchPath match_claim, CandidateList* lists, int lists_size, CandidateQuery* query) {
+    StoreRef candidate;
+    while ((MATCHER_ENTRY_LIMIT == 0 || query->matched < MATCHER_ENTRY_LIMIT) && (candidate = NextCandidate(lists, lists_size)) != NULL) {
+        if (!AuthorityTrusted(query, candidate)) {
+            continue;
+        }
+        if (query->claims != NULL && !ClaimPlanMayMatch(&query->plan, candidate)) {
+            continue;
+        }
+        cJSON* matched_credential = cJSON_CreateObject();
+        StoreAddItemToObject(matched_credential, "id", StoreGetObjectItemCaseSensitive(candidate, "id"));
+        StoreAddItemToObject(matched_credential, "title", StoreGetObjectItemCaseSensitive(candidate, "title"));
+        StoreAddItemToObject(matched_credential, "subtitle", StoreGetObjectItemCaseSensitive(candidate, "subtitle"));
+        StoreAddItemToObject(matched_credential, "icon", StoreGetObjectItemCaseSensitive(candidate, "icon"));
+        StoreRef candidate_claims = StoreGetObjectItemCaseSensitive(candidate, "paths");
+
+        // Match on the claims
+        if (query->claims == NULL) {
+            // Match every candidate, with the displays of all of its claims as the registry
+            // writer lists them, or as AddAllClaims finds them in registries written before
+            StoreRef displays = StoreGetObjectItemCaseSensitive(candidate, "displays");
+            if (StoreIsArray(displays)) {
+                StoreAddItemToObject(matched_credential, "matched_claim_names", displays);
+            } else {
+                cJSON* matched_claim_names = cJSON_CreateArray();
+                AddAllClaims(matched_claim_names, candidate_claims);
                 cJSON_AddItemReferenceToObject(matched_credential, "matched_claim_names", matched_claim_names);
-                if (cJSON_GetArraySize(matched_claim_names) == cJSON_GetArraySize(claims)) {
-                    cJSON_AddItemReferenceToArray(matched_credentials, matched_credential);
+            }
+            AddMatchedCredential(query, matched_credential);
+        } else if (query->claim_sets == NULL) {
+            cJSON* matched_claim_names = cJSON_CreateArray();
+            for (int i = 0; i < query->claims_size; i++) {
+                const QueryClaim* claim = &query->query_claims[i];
+                StoreRef display = match_claim(candidate_claims, claim);
+                if (display != NULL) {
+                    StoreAddItemToArray(matched_claim_names, display);
                 }
             }
+            cJSON_AddItemReferenceToObject(matched_credential, "matched_claim_names", matched_claim_names);
+            if (cJSON_GetArraySize(matched_claim_names) == query->claims_size) {
+                AddMatchedCredential(query, matched_credential);
+            }
         } else {
-            cJSON* candidate;
-            cJSON_ArrayForEach(candidate, candidates) {
-                cJSON* matched_credential = cJSON_CreateObject();
-                cJSON_AddItemReferenceToObject(matched_credential, "id", cJSON_GetObjectItemCaseSensitive(candidate, "id"));
-                cJSON_AddItemReferenceToObject(matched_credential, "title", cJSON_GetObjectItemCaseSensitive(candidate, "title"));
-                cJSON_AddItemReferenceToObject(matched_credential, "subtitle", cJSON_GetObjectItemCaseSensitive(candidate, "subtitle"));
-                cJSON_AddItemReferenceToObject(matched_credential, "icon", cJSON_GetObjectItemCaseSensitive(candidate, "icon"));
-                cJSON* matched_claim_ids = cJSON_CreateObject();
-
-                cJSON* claim;
-                cJSON* candidate_claims = cJSON_GetObjectItemCaseSensitive(candidate, "paths");
-                cJSON_ArrayForEach(claim, claims) {
-                    cJSON* claim_values = cJSON_GetObjectItemCaseSensitive(claim, "values");
-                    char* claim_id = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(claim, "id"));
-                    cJSON* paths = cJSON_GetObjectItemCaseSensitive(claim, "path");
-                    cJSON* curr_path;
-                    cJSON* curr_claim = candidate_claims;
-                    int matched = 1;
-                    cJSON_ArrayForEach(curr_path, paths) {
-                        char* path_value = cJSON_GetStringValue(curr_path);
-                        if (cJSON_HasObjectItem(curr_claim, path_value)) {
-                            curr_claim = cJSON_GetObjectItemCaseSensitive(curr_claim, path_value);
-                        } else {
-                            matched = 0;
-                            break;
-                        }
-                    }
-                    if (matched != 0 && curr_claim != NULL && cJSON_HasObjectItem(curr_claim, "display")) {
-                        if (claim_values != NULL) {
-                            cJSON* v;
-                            cJSON_ArrayForEach(v, claim_values) {
-                                if (cJSON_Compare(v, cJSON_GetObjectItemCaseSensitive(curr_claim, "value"), cJSON_True)) {
-                                    cJSON_AddItemReferenceToObject(matched_claim_ids, claim_id, cJSON_GetObjectItem(curr_claim, "display"));
-                                    break;
-                                }
-                            }
-                        } else {
-                            cJSON_AddItemReferenceToObject(matched_claim_ids, claim_id, cJSON_GetObjectItem(curr_claim, "display"));
-                        }
-                    }
+            cJSON* matched_claim_ids = cJSON_CreateObject();
+            for (int i = 0; i < query->claims_size; i++) {
+                const QueryClaim* claim = &query->query_claims[i];
+                StoreRef display = match_claim(candidate_claims, claim);
+                if (display != NULL) {
+                    StoreAddItemToObject(matched_claim_ids, claim->id, display);
                 }
-                cJSON* claim_set;
-                cJSON_ArrayForEach(claim_set, claim_sets) {
-                    cJSON* matched_claim_names = cJSON_CreateArray();
-                    cJSON* c;
-                    cJSON_ArrayForEach(c, claim_set) {
-                        if (cJSON_HasObjectItem(matched_claim_ids, cJSON_GetStringValue(c))) {
-                            cJSON_AddItemReferenceToArray(matched_claim_names, cJSON_GetObjectItemCaseSensitive(matched_claim_ids, cJSON_GetStringValue(c)));
-                        }
-                    }
-                    if (cJSON_GetArraySize(matched_claim_names) == cJSON_GetArraySize(claim_set)) {
-                        cJSON_AddItemReferenceToObject(matched_credential, "matched_claim_names", matched_claim_names);
-                        cJSON_AddItemReferenceToArray(matched_credentials, matched_credential);
-                        break;
+            }
+            cJSON* claim_set;
+            int claim_set_index = 0;
+            cJSON_ArrayForEach(claim_set, query->claim_sets) {
+                cJSON* matched_claim_names = cJSON_CreateArray();
+                cJSON* c;
+                cJSON_ArrayForEach(c, claim_set) {
+                    if (cJSON_HasObjectItem(matched_claim_ids, cJSON_GetStringValue(c))) {
+                        cJSON_AddItemReferenceToArray(matched_claim_names, cJSON_GetObjectItemCaseSensitive(matched_claim_ids, cJSON_GetStringValue(c)));
                     }
                 }
+                if (cJSON_GetArraySize(matched_claim_names) == cJSON_GetArraySize(claim_set)) {
+                    cJSON_AddItemReferenceToObject(matched_credential, "matched_claim_names", matched_claim_names);
+                    // The claims to present once the credential is selected, see dcql_engine.h
+                    cJSON_AddNumberToObject(matched_credential, "claim_set", claim_set_index);
+                    AddMatchedCredential(query, matched_credential);
+                    break;
+                }
+                claim_set_index++;
             }
         }
     }
+}
+
+#define DEFINE_MATCH_CANDIDATES(kernel)                                                     \
+    static void MatchCandidates##kernel(CandidateList* lists, int lists_size, CandidateQuery* query) { \
+        MatchCandidatesWith(Match##kernel##Claim, lists, lists_size, query);                           \
+    }
+
+DEFINE_MATCH_CANDIDATES(Mdoc)
+DEFINE_MATCH_CANDIDATES(SdJwt)
+
+cJSON* MatchCredential(cJSON* credential, StoreRef credential_store) {
+    cJSON* matched_credentials = cJSON_CreateArray();
+    char* format = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(credential, "format"));
+
+    // check for optional params
+    cJSON* meta = cJSON_GetObjectItemCaseSensitive(credential, "meta");
+    cJSON* claims = cJSON_GetObjectItemCaseSensitive(credential, "claims");
+    cJSON* claim_sets = cJSON_GetObjectItemCaseSensitive(credential, "claim_sets");
+
+    StoreRef candidates = StoreGetObjectItemCaseSensitive(credential_store, format);
+
+    if (candidates == NULL) {
+        return matched_credentials;
+    }
+    if (meta != NULL && strcmp(format, "mso_mdoc") != 0 && strcmp(format, "dc+sd-jwt") != 0) {
+        return matched_credentials;
+    }
+
+    CandidateQuery query = {
+        .claims = claims,
+        .claim_sets = claim_sets,
+        .trusted_authorities = CompileTrustedAuthorities(cJSON_GetObjectItemCaseSensitive(credential, "trusted_authorities")),
+        .matched_credentials = matched_credentials,
+    };
+    if (query.trusted_authorities != NULL) {
+        query.trusted_authorities_len = strlen(query.trusted_authorities);
+    }
+    if (claims != NULL) {
+        CompileClaims(&query);
+        // Candidates whose path filter lacks a requested path are skipped before resolving any
+        PlanClaims(claims, claim_sets, &query.plan);
+    }
+
+    // Filter by meta, each doctype or vct being a list of candidates
+    CandidateList* lists;
+    int lists_size = 0;
+    cJSON* doctype_value = cJSON_GetObjectItemCaseSensitive(meta, "doctype_value");
+    cJSON* vct_values = cJSON_GetObjectItemCaseSensitive(meta, "vct_values");
+    if (strcmp(format, "mso_mdoc") == 0 && doctype_value != NULL) {
+        lists = malloc(sizeof(CandidateList));
+        lists[lists_size++].candidates = StoreGetObjectItemCaseSensitive(candidates, cJSON_GetStringValue(doctype_value));
+    } else if (strcmp(format, "mso_mdoc") != 0 && meta != NULL) {
+        lists = malloc(sizeof(CandidateList) * (cJSON_GetArraySize(vct_values) + 1));
+        cJSON* vct_value;
+        cJSON_ArrayForEach(vct_value, vct_values) {
+            lists[lists_size++].candidates = StoreGetObjectItemCaseSensitive(candidates, cJSON_GetStringValue(vct_value));
+        }
+    } else {
+        lists = malloc(sizeof(CandidateList) * (StoreGetArraySize(candidates) + 1));
+        StoreRef type_candidates;
+        StoreArrayForEach(type_candidates, candidates) {
+            lists[lists_size++].candidates = type_candidates;
+        }
+    }
+    for (int i = 0; i < lists_size; i++) {
+        AdvanceCandidateList(&lists[i], StoreFirstChild(lists[i].candidates));
+    }
+
+    // The kernel of the format, for all of the candidates
+    if (strcmp(format, "mso_mdoc") == 0) {
+        MatchCandidatesMdoc(lists, lists_size, &query);
+    } else {
+        MatchCandidatesSdJwt(lists, lists_size, &query);
+    }
+    free(lists);
 
+    if (claims != NULL) {
+        FreeClaimPlan(&query.plan);
+        free(query.query_claims);
+    }
+    free(query.trusted_authorities);
     return matched_credentials;
 }
 
-cJSON* dcql_query(cJSON* query, cJSON* credential_store) {
+cJSON* dcql_query(cJSON* query, StoreRef credential_store) {
     cJSON* matched_credentials = cJSON_CreateObject();
     cJSON* candidate_matched_credentials = cJSON_CreateObject();
     cJSON* credentials = cJSON_GetObjectItemCaseSensitive(query, "credentials");
@@ -2,7 +2,20 @@
 #define DCQL_H
 
 #include "cJSON/cJSON.h"
+#include "store.h"
 
-cJSON* dcql_query(cJSON* query, cJSON* credential_store);
+// Most credentials a credential query matches, and entries a matcher adds, 0 for no limit. The
+// selector only shows a few, so with LIMIT=<n> broad queries against large wallets stop early.
+// Candidates are matched by descending registry "priority", see NextCandidate in dcql.c, and in
+// registry order by the pnv matcher.
+#if !defined(MATCHER_ENTRY_LIMIT)
+#define MATCHER_ENTRY_LIMIT 0
+#endif
+
+static inline int EntryLimitReached(int entries) {
+    return MATCHER_ENTRY_LIMIT > 0 && entries >= MATCHER_ENTRY_LIMIT;
+}
+
+cJSON* dcql_query(cJSON* query, StoreRef credential_store);
 
 #endif
\ No newline at end of file
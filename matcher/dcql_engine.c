@@ -0,0 +1,163 @@
+#include <stdlib.h>
+
+#include "cJSON/cJSON.h"
+
+#include "dcql.h"
+#include "dcql_engine.h"
+#include "store.h"
+
+struct DcqlStore {
+#if defined(REGISTRY_TAPE)
+    TapeEntry* tape;
+#else
+    cJSON* json;
+#endif
+    StoreRef credentials;
+};
+
+// dcql_query only ever adds to its result, which references the query and the store rather than
+// copying them, and leaves nothing to free. Matches parse their query and run it with cJSON
+// allocating from an arena of the match, released all at once.
+typedef struct ArenaChunk {
+    struct ArenaChunk* next;
+    size_t used;
+    size_t cap;
+} ArenaChunk;
+
+#define ARENA_CHUNK_SIZE 16384
+
+struct DcqlMatch {
+    ArenaChunk* arena;
+    cJSON* result;
+};
+
+// The match being run, for the cJSON hooks.
+static DcqlMatch* running;
+
+static void* CJSON_CDECL ArenaMalloc(size_t size) {
+    size = (size + 7) & ~(size_t)7;
+    ArenaChunk* arena = running->arena;
+    if (arena == NULL || arena->used + size > arena->cap) {
+        size_t cap = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+        ArenaChunk* chunk = malloc(sizeof(ArenaChunk) + cap);
+        chunk->next = arena;
+        chunk->used = 0;
+        chunk->cap = cap;
+        running->arena = arena = chunk;
+    }
+    void* p = (char*)(arena + 1) + arena->used;
+    arena->used += size;
+    return p;
+}
+
+static void CJSON_CDECL ArenaFree(void* p) {
+    (void)p;
+}
+
+int DcqlEngineApiVersion(void) {
+    return DCQL_ENGINE_API_VERSION;
+}
+
+DcqlStore* DcqlStoreParse(const char* registry_json) {
+    DcqlStore* store = malloc(sizeof(DcqlStore));
+#if defined(REGISTRY_TAPE)
+    store->tape = TapeParse(registry_json);
+    if (store->tape == NULL) {
+        free(store);
+        return NULL;
+    }
+    store->credentials = TapeGetObjectItem(store->tape, "credentials");
+#else
+    store->json = cJSON_Parse(registry_json);
+    if (store->json == NULL) {
+        free(store);
+        return NULL;
+    }
+    store->credentials = cJSON_GetObjectItem(store->json, "credentials");
+#endif
+    return store;
+}
+
+void DcqlStoreFree(DcqlStore* store) {
+    if (store == NULL) {
+        return;
+    }
+#if defined(REGISTRY_TAPE)
+    free(store->tape);
+#else
+    cJSON_Delete(store->json);
+#endif
+    free(store);
+}
+
+DcqlMatch* DcqlMatchQuery(const DcqlStore* store, const char* dcql_query_json) {
+    DcqlMatch* match = malloc(sizeof(DcqlMatch));
+    match->arena = NULL;
+    match->result = NULL;
+
+    running = match;
+    cJSON_Hooks hooks = {ArenaMalloc, ArenaFree};
+    cJSON_InitHooks(&hooks);
+    cJSON* query = cJSON_Parse(dcql_query_json);
+    if (query != NULL) {
+        match->result = dcql_query(query, store->credentials);
+    }
+    cJSON_InitHooks(NULL);
+    running = NULL;
+
+    if (query == NULL) {
+        DcqlMatchFree(match);
+        return NULL;
+    }
+    return match;
+}
+
+void DcqlMatchFree(DcqlMatch* match) {
+    if (match == NULL) {
+        return;
+    }
+    while (match->arena != NULL) {
+        ArenaChunk* next = match->arena->next;
+        free(match->arena);
+        match->arena = next;
+    }
+    free(match);
+}
+
+static cJSON* MatchedCredentials(const DcqlMatch* match, int query) {
+    return cJSON_GetObjectItemCaseSensitive(cJSON_GetArrayItem(match->result, query), "matched");
+}
+
+static cJSON* MatchedCredential(const DcqlMatch* match, int query, int credential) {
+    return cJSON_GetArrayItem(MatchedCredentials(match, query), credential);
+}
+
+int DcqlMatchQueryCount(const DcqlMatch* match) {
+    return cJSON_GetArraySize(match->result);
+}
+
+const char* DcqlMatchQueryId(const DcqlMatch* match, int query) {
+    return cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(cJSON_GetArrayItem(match->result, query), "id"));
+}
+
+int DcqlMatchCredentialCount(const DcqlMatch* match, int query) {
+    return cJSON_GetArraySize(MatchedCredentials(match, query));
+}
+
+const char* DcqlMatchCredentialId(const DcqlMatch* match, int query, int credential) {
+    return cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(MatchedCredential(match, query, credential), "id"));
+}
+
+int DcqlMatchClaimSet(const DcqlMatch* match, int query, int credential) {
+    cJSON* claim_set = cJSON_GetObjectItemCaseSensitive(MatchedCredential(match, query, credential), "claim_set");
+    return cJSON_IsNumber(claim_set) ? claim_set->valueint : -1;
+}
+
+int DcqlMatchClaimCount(const DcqlMatch* match, int query, int credential) {
+    return cJSON_GetArraySize(cJSON_GetObjectItemCaseSensitive(MatchedCredential(match, query, credential), "matched_claim_names"));
+}
+
+const char* DcqlMatchClaimDisplay(const DcqlMatch* match, int query, int credential, int claim) {
+    cJSON* displays = cJSON_GetObjectItemCaseSensitive(MatchedCredential(match, query, credential), "matched_claim_names");
+    return cJSON_GetStringValue(cJSON_GetArrayItem(displays, claim));
+}
@@ -0,0 +1,49 @@
+#ifndef DCQL_ENGINE_H
+#define DCQL_ENGINE_H
+
+#include <stddef.h>
+
+// The DCQL matching of the matchers as a library, for the wallet to match the credential the user
+// selected against the request again with the same results. Built for the app by
+// app/src/main/cpp/CMakeLists.txt, see DcqlEngine.kt, and for the host by make engine.
+//
+// Stores and matches are opaque handles owned by the caller. Strings passed in are NUL terminated
+// UTF-8 and only read during the call, strings returned stay valid until their handle is freed.
+// The engine swaps the cJSON allocator while matching, so calls must not run concurrently with
+// each other or with other cJSON users in the process.
+//
+// Additions keep the existing functions and their behaviour, anything else bumps the version.
+#define DCQL_ENGINE_API_VERSION 1
+
+typedef struct DcqlStore DcqlStore;
+typedef struct DcqlMatch DcqlMatch;
+
+int DcqlEngineApiVersion(void);
+
+// Parses the credential json of a registry, see registry.h, whose "credentials" are matched
+// against. Returns NULL if it isn't json.
+DcqlStore* DcqlStoreParse(const char* registry_json);
+void DcqlStoreFree(DcqlStore* store);
+
+// Runs the DCQL query, the "dcql_query" of an OpenID4VP request, against the store. Returns NULL
+// if it isn't json. The match reads the store, which has to outlive it.
+DcqlMatch* DcqlMatchQuery(const DcqlStore* store, const char* dcql_query_json);
+void DcqlMatchFree(DcqlMatch* match);
+
+// The credential queries that matched any credential, in query order.
+int DcqlMatchQueryCount(const DcqlMatch* match);
+const char* DcqlMatchQueryId(const DcqlMatch* match, int query);
+
+// The credentials a credential query matched, in the order the matchers offer them.
+int DcqlMatchCredentialCount(const DcqlMatch* match, int query);
+const char* DcqlMatchCredentialId(const DcqlMatch* match, int query, int credential);
+
+// The index in claim_sets of the first claim set the credential satisfies, -1 for queries without
+// claim sets, whose claims are all matched.
+int DcqlMatchClaimSet(const DcqlMatch* match, int query, int credential);
+
+// The displays of the claims the credential matched, as the matchers show them.
+int DcqlMatchClaimCount(const DcqlMatch* match, int query, int credential);
+const char* DcqlMatchClaimDisplay(const DcqlMatch* match, int query, int credential, int claim);
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef DEBUG_H
+#define DEBUG_H
+
+// Diagnostic output of the matchers, only compiled in with MATCHER_DEBUG. Release builds drop the
+// call together with its arguments, which keeps printf and cJSON_Print out of the module.
+#if defined(MATCHER_DEBUG)
+#include <stdio.h>
+#define DEBUG_LOG(...) printf(__VA_ARGS__)
+#else
+#define DEBUG_LOG(...) do { } while (0)
+#endif
+
+#endif
@@ -0,0 +1,660 @@
+"""Differential testing oracle for the matchers.
+
+Builds a reference matcher (from a git revision) and a candidate matcher (from the working tree)
+against the native host shim in testharness.c, feeds both the same generated registries and
+DCQL requests, and diffs the emitted AddStringIdEntry / AddFieldForStringIdEntry /
+AddPaymentEntry call streams. Failing cases are shrunk before they are reported.
+
+    $ cd <project-root>/matcher
+    $ python3 difftest.py --reference-rev origin/main --matcher openid4vp1_0 --cases 500
+
+A failing case is written to --out as request.json / testcreds.json, ready to be replayed with
+the regular testharness build.
+
+With --engine the host build of the DCQL engine, see dcql_engine.h, is compared against the
+openid4vp1_0 matcher of the working tree instead:
+
+    $ make engine && python3 difftest.py --engine out/native/libdcql.so --cases 200
+"""
+
+import argparse
+import ast
+import base64
+import copy
+import ctypes
+import difflib
+import json
+import os
+import random
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+
+MATCHER_DIR = os.path.dirname(os.path.abspath(__file__))
+
+# The file holding main() and the dcql implementation of each matcher. Every other .c file at the
+# root of matcher/ is shared and linked into all of them.
+MATCHERS = {
+    "openid4vp1_0": ["openid4vp1_0.c", "dcql.c"],
+    "openid4vp": ["openid4vp.c", "dcql.c"],
+}
+# dcql_engine.c is the library build of dcql.c and not part of any matcher.
+NOT_SHARED = {"openid4vp1_0.c", "openid4vp.c", "dcql.c", "dcql_engine.c", "testharness.c"}
+# The host shim and what it needs on top of the matcher sources.
+HARNESS_FILES = ["testharness.c", "trace.c", "trace.h", "batch.c", "batch.h"]
+
+PROTOCOLS = {
+    "openid4vp1_0": ["openid4vp-v1-unsigned", "openid4vp-v1-signed"],
+    "openid4vp": ["openid4vp"],
+}
+
+MDOC_DOCTYPES = {
+    "org.iso.18013.5.1.mDL": {
+        "org.iso.18013.5.1": ["family_name", "given_name", "birth_date", "age_over_21", "document_number"],
+        "org.iso.18013.5.1.aamva": ["DHS_compliance", "organ_donor"],
+    },
+    "eu.europa.ec.eudi.pid.1": {
+        "eu.europa.ec.eudi.pid.1": ["family_name", "given_name", "nationality", "age_over_18"],
+    },
+    "com.example.payment_card": {
+        "com.example.payment_card": ["holder_name", "card_number", "expiry"],
+    },
+}
+SDJWT_VCTS = {
+    "urn:eudi:pid:1": ["family_name", "given_name", "birthdate", ["address", "locality"], ["address", "country"]],
+    "https://credentials.example.com/identity_credential": ["given_name", "email", ["age_equal_or_over", "18"]],
+}
+VALUES = ["Wayne", "Kent", "Prince", True, False, 21, "US", "DE"]
+
+# Issuer logos shared between credentials, so that the registry icon table has duplicates.
+SHARED_ICONS = [b"", b"\x89PNG issuer 1", b"\x89PNG issuer 2"]
+
+# Write icons inline in each credential, as registries did before the icon table. Needed when
+# the reference revision predates the table.
+LEGACY_REGISTRY = False
+
+
+class Case:
+    """A registry plus a request. Kept as plain data so that shrinking can drop pieces of it."""
+
+    def __init__(self, store, requests):
+        self.store = store  # list of registry credentials, each tagged with "format" and "type"
+        self.requests = requests  # list of {"protocol", "dcql_query", "transaction_data"}
+
+    def copy(self):
+        return Case(copy.deepcopy(self.store), copy.deepcopy(self.requests))
+
+
+def b64url(data):
+    return base64.urlsafe_b64encode(data).decode()
+
+
+def encode_json_payload(obj):
+    # B64DecodeURL does not terminate its output, it relies on the zero bytes produced by the
+    # '=' padding. Pad the json with spaces so the encoding always carries padding.
+    text = json.dumps(obj)
+    while len(text) % 3 == 0:
+        text += " "
+    return b64url(text.encode())
+
+
+def fnv1a(data, h=2166136261):
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xffffffff
+    return h
+
+
+REGISTRY_FORMATS = {"mso_mdoc": 0x1, "dc+sd-jwt": 0x2, "dc-authorization+sd-jwt": 0x4}
+
+
+def build_summary(credentials, content=b""):
+    """The summary written after the json offset, see registry.h, for the content after it."""
+    formats = 0
+    hashes = set()
+    for fmt, types in credentials.items():
+        if types:
+            formats |= REGISTRY_FORMATS.get(fmt, 0x80000000)
+        hashes.update(fnv1a(t.encode()) for t in types)
+    hashes = sorted(hashes)
+    return b"CMRS" + struct.pack("<III%dII" % len(hashes), 20 + 4 * len(hashes), formats, len(hashes), *hashes,
+                                 fnv1a(content))
+
+
+def build_path_filter(paths):
+    """The Bloom filter of every member path under paths, see path_filter.h."""
+    hashes = []
+
+    def walk(node, h):
+        for key, value in node.items():
+            hk = fnv1a(key.encode() + b"\0", h)
+            hashes.append(hk)
+            if isinstance(value, dict):
+                walk(value, hk)
+    walk(paths, 2166136261)
+    words = [0] * min(64, max(1, (len(hashes) * 10 + 31) // 32))
+    for h in hashes:
+        step = (((h >> 16) | (h << 16)) & 0xffffffff) | 1
+        for i in range(3):
+            bit = ((h + i * step) & 0xffffffff) % (32 * len(words))
+            words[bit // 32] |= 1 << (bit % 32)
+    return words
+
+
+def build_displays(paths):
+    """The display of every claim under paths, in the order AddAllClaims in dcql.c finds them."""
+    displays = []
+
+    def walk(node):
+        for value in node.values():
+            if isinstance(value, dict):
+                if "display" in value:
+                    displays.append(value["display"])
+                else:
+                    walk(value)
+    walk(paths)
+    return displays
+
+
+def build_registry(store):
+    """Serializes the store the same way CredentialRepository.createRegistryDatabase does."""
+    credentials = {}
+    for cred in store:
+        credentials.setdefault(cred["format"], {}).setdefault(cred["type"], [])
+    summary = b"" if LEGACY_REGISTRY else build_summary(credentials)
+    icons = bytearray()
+    icon_table = []
+    icon_ids = {}
+    start = 4 + len(summary)
+    for cred in store:
+        entry = {k: v for k, v in cred.items() if k not in ("format", "type", "icon_bytes")}
+        icon = cred["icon_bytes"]
+        if not LEGACY_REGISTRY:
+            entry["path_filter"] = build_path_filter(cred["paths"])
+            entry["displays"] = build_displays(cred["paths"])
+        if LEGACY_REGISTRY:
+            entry["icon"] = {"start": start + len(icons), "length": len(icon)}
+            icons += icon
+        else:
+            if icon not in icon_ids:
+                icon_ids[icon] = len(icon_table)
+                icon_table.append({"start": start + len(icons), "length": len(icon)})
+                icons += icon
+            entry["icon"] = icon_ids[icon]
+        credentials.setdefault(cred["format"], {}).setdefault(cred["type"], []).append(entry)
+    registry = {"credentials": credentials}
+    if not LEGACY_REGISTRY:
+        registry["icons"] = icon_table
+    content = bytes(icons) + json.dumps(registry).encode() + b"\0"
+    if not LEGACY_REGISTRY:
+        # Its length doesn't depend on the content hash
+        summary = build_summary(credentials, content)
+    return struct.pack("<i", start + len(icons)) + summary + content
+
+
+def build_request(case):
+    requests = []
+    for r in case.requests:
+        data = {"response_type": "vp_token", "nonce": "difftest", "dcql_query": r["dcql_query"]}
+        if r.get("transaction_data") is not None:
+            data["transaction_data"] = [encode_json_payload(td) for td in r["transaction_data"]]
+        if r["protocol"].endswith("-signed"):
+            header = encode_json_payload({"alg": "none"})
+            data = {"request": header + "." + encode_json_payload(data) + ".sig"}
+        if r.get("string_data"):
+            data = json.dumps(data)  # Legacy spec
+        if r.get("mdoc_before"):
+            # A request for a protocol no matcher handles, which has to be skipped unparsed
+            requests.append({"protocol": "org-iso-mdoc",
+                             "data": {"deviceRequest": b64url(bytes(range(256)) * 16), "quote": "\\\"]}"}})
+        requests.append({"protocol": r["protocol"], "data": data})
+    return json.dumps({"requests": requests}).encode() + b"\0"
+
+
+def gen_paths(rng, fmt, cred_type):
+    paths = {}
+    if fmt == "mso_mdoc":
+        for namespace, elements in MDOC_DOCTYPES[cred_type].items():
+            for element in elements:
+                if rng.random() < 0.8:
+                    paths.setdefault(namespace, {})[element] = {
+                        "value": rng.choice(VALUES), "display": element.replace("_", " ").title()}
+    else:
+        for claim in SDJWT_VCTS[cred_type]:
+            if rng.random() < 0.8:
+                path = claim if isinstance(claim, list) else [claim]
+                node = paths
+                for p in path[:-1]:
+                    node = node.setdefault(p, {})
+                node[path[-1]] = {"value": rng.choice(VALUES), "display": " ".join(path)}
+    return paths
+
+
+def gen_store(rng):
+    store = []
+    for i in range(rng.randint(0, 8)):
+        fmt = rng.choice(["mso_mdoc", "dc+sd-jwt"])
+        cred_type = rng.choice(list(MDOC_DOCTYPES if fmt == "mso_mdoc" else SDJWT_VCTS))
+        store.append({
+            "format": fmt,
+            "type": cred_type,
+            "id": str(i + 1),
+            "title": "Credential %d" % (i + 1),
+            "subtitle": rng.choice([cred_type, "Issuer %d" % rng.randint(1, 3)]),
+            "icon_bytes": rng.choice(SHARED_ICONS + [bytes(rng.randrange(256) for _ in range(rng.randint(1, 16)))]),
+            "paths": gen_paths(rng, fmt, cred_type),
+        })
+    return store
+
+
+def gen_claim_path(rng, fmt, cred_type):
+    if fmt == "mso_mdoc":
+        namespace = rng.choice(list(MDOC_DOCTYPES[cred_type]))
+        return [namespace, rng.choice(MDOC_DOCTYPES[cred_type][namespace] + ["missing"])]
+    claim = rng.choice(SDJWT_VCTS[cred_type] + ["missing"])
+    return claim if isinstance(claim, list) else [claim]
+
+
+def gen_credential_query(rng, index):
+    fmt = rng.choice(["mso_mdoc", "dc+sd-jwt"])
+    cred_type = rng.choice(list(MDOC_DOCTYPES if fmt == "mso_mdoc" else SDJWT_VCTS))
+    query = {"id": "cred_%d" % index, "format": fmt}
+    if rng.random() < 0.9:
+        if fmt == "mso_mdoc":
+            query["meta"] = {"doctype_value": cred_type}
+        else:
+            query["meta"] = {"vct_values": [cred_type]}
+    if rng.random() < 0.7:
+        claims = []
+        for c in range(rng.randint(1, 4)):
+            claim = {"id": "claim_%d" % c, "path": gen_claim_path(rng, fmt, cred_type)}
+            if rng.random() < 0.2:
+                claim["values"] = rng.sample(VALUES, rng.randint(1, 3))
+            claims.append(claim)
+        query["claims"] = claims
+        if rng.random() < 0.3:
+            ids = [c["id"] for c in claims]
+            query["claim_sets"] = [rng.sample(ids, rng.randint(1, len(ids))) for _ in range(rng.randint(1, 3))]
+    if "meta" in query and rng.random() < 0.25:
+        # A type no store holds, which the registry summary rules out
+        if fmt == "mso_mdoc":
+            query["meta"]["doctype_value"] = "org.example.unheld"
+        else:
+            query["meta"]["vct_values"] = rng.choice([[], ["urn:example:unheld"], ["urn:example:unheld", cred_type]])
+    return query
+
+
+def gen_case(rng, matcher):
+    requests = []
+    for _ in range(rng.randint(1, 3)):
+        if requests and rng.random() < 0.3:
+            # The same query under another protocol, as verifiers do for signed and unsigned
+            # requests; the members are shuffled since their order does not matter.
+            credentials = [dict(rng.sample(list(q.items()), len(q)))
+                           for q in requests[-1]["dcql_query"]["credentials"]]
+        else:
+            credentials = [gen_credential_query(rng, i) for i in range(rng.randint(1, 3))]
+        request = {"protocol": rng.choice(PROTOCOLS[matcher]), "dcql_query": {"credentials": credentials}}
+        if rng.random() < 0.2:
+            request["string_data"] = True
+        if rng.random() < 0.2:
+            request["mdoc_before"] = True
+        if rng.random() < 0.15:
+            request["transaction_data"] = [{
+                "type": "payment_card",
+                "credential_ids": rng.sample([c["id"] for c in credentials], rng.randint(1, len(credentials))),
+                "merchant_name": "Merchant %d" % t,
+                "amount": "US$%d.00" % rng.randint(1, 100),
+            } for t in range(rng.choice([1, 1, 2, 3]))]
+        requests.append(request)
+    return Case(gen_store(rng), requests)
+
+
+def export_sources(rev, dest):
+    """Exports matcher/ at rev, or copies the working tree when rev is None."""
+    if rev is None:
+        shutil.copytree(MATCHER_DIR, dest, dirs_exist_ok=True)
+        return
+    archive = subprocess.run(["git", "archive", rev, "."], cwd=MATCHER_DIR, check=True, capture_output=True).stdout
+    subprocess.run(["tar", "-x", "-C", dest], input=archive, check=True)
+
+
+def build_matcher(rev, matcher, workdir, name, cflags=()):
+    src = os.path.join(workdir, name + "_src")
+    os.makedirs(src)
+    export_sources(rev, src)
+    # The host shim is the measuring instrument, not the code under test, so both sides always
+    # use the one from the working tree.
+    for f in HARNESS_FILES:
+        shutil.copy(os.path.join(MATCHER_DIR, f), os.path.join(src, f))
+    shared = [f for f in sorted(os.listdir(src)) if f.endswith(".c") and f not in NOT_SHARED]
+    sources = MATCHERS[matcher] + shared + ["cJSON/cJSON.c", "testharness.c"]
+    binary = os.path.join(workdir, name)
+    cc = os.environ.get("CC", "cc")
+    subprocess.run([cc, "-O1", "-w"] + list(cflags) + ["-o", binary] + sources, cwd=src, check=True)
+    return binary
+
+
+def run_matcher(binary, case, workdir):
+    request_path = os.path.join(workdir, "request.json")
+    creds_path = os.path.join(workdir, "testcreds.json")
+    calls_path = os.path.join(workdir, "calls.txt")
+    with open(request_path, "wb") as f:
+        f.write(build_request(case))
+    with open(creds_path, "wb") as f:
+        f.write(build_registry(case.store))
+    env = dict(os.environ, CREDMAN_REQUEST_PATH=request_path, CREDMAN_CREDS_PATH=creds_path,
+               CREDMAN_CALLS_PATH=calls_path)
+    if os.path.exists(calls_path):
+        os.remove(calls_path)
+    try:
+        proc = subprocess.run([binary], env=env, cwd=workdir, capture_output=True, timeout=20)
+        status = "exit %d" % proc.returncode
+    except subprocess.TimeoutExpired:
+        status = "timeout"
+    calls = []
+    if os.path.exists(calls_path):
+        with open(calls_path, encoding="utf-8", errors="replace") as f:
+            calls = [normalize_call(line.rstrip("\n")) for line in f]
+    return calls + ["<%s>" % status]
+
+
+def decode_varint(raw, pos):
+    value = shift = 0
+    while True:
+        byte = raw[pos]
+        pos += 1
+        value |= (byte & 0x7f) << shift
+        shift += 7
+        if byte < 0x80:
+            return value, pos
+
+
+def decode_entry_id(entry_id):
+    """Returns (request index, credential id, dcql credential id) of a json or encoded entry id,
+    see entry_id.h."""
+    if entry_id.startswith("{"):
+        obj = json.loads(entry_id)
+        return (obj.get("provider_idx", obj.get("req_idx")), obj.get("id", obj.get("entry_id", "")),
+                obj.get("dcql_cred_id", ""))
+    raw = base64.urlsafe_b64decode(entry_id + "=" * (-len(entry_id) % 4))
+    if raw[0] != 1:
+        return entry_id
+    request_idx, pos = decode_varint(raw, 1)
+    fields = []
+    for _ in range(2):
+        length, pos = decode_varint(raw, pos)
+        fields.append(raw[pos:pos + length].decode())
+        pos += length
+    return (request_idx, fields[0], fields[1])
+
+
+def normalize_call(record):
+    """Compares entry ids by their content, so json ids match the encoded ones of entry_id.h."""
+    fields = record.split("\t")
+    if len(fields) > 1 and fields[1] not in ("(null)", "ISSUANCE"):
+        try:
+            fields[1] = "%r" % (decode_entry_id(fields[1]),)
+        except (ValueError, IndexError):
+            pass
+    return "\t".join(fields)
+
+
+def differs(reference, candidate, case, workdir):
+    return run_matcher(reference, case, workdir) != run_matcher(candidate, case, workdir)
+
+
+def shrink_candidates(case):
+    """Yields strictly smaller variants of case, coarse edits first."""
+    for i in range(len(case.requests)):
+        c = case.copy()
+        del c.requests[i]
+        yield c
+    for i in range(len(case.store)):
+        c = case.copy()
+        del c.store[i]
+        yield c
+    for r in range(len(case.requests)):
+        credentials = case.requests[r]["dcql_query"]["credentials"]
+        if case.requests[r].get("transaction_data") is not None:
+            c = case.copy()
+            del c.requests[r]["transaction_data"]
+            yield c
+        for q in range(len(credentials)):
+            c = case.copy()
+            del c.requests[r]["dcql_query"]["credentials"][q]
+            yield c
+            query = credentials[q]
+            for key in ("claim_sets", "meta", "claims"):
+                if key in query:
+                    c = case.copy()
+                    del c.requests[r]["dcql_query"]["credentials"][q][key]
+                    yield c
+            for cl in range(len(query.get("claims", []))):
+                c = case.copy()
+                del c.requests[r]["dcql_query"]["credentials"][q]["claims"][cl]
+                yield c
+                if "values" in query["claims"][cl]:
+                    c = case.copy()
+                    del c.requests[r]["dcql_query"]["credentials"][q]["claims"][cl]["values"]
+                    yield c
+    for s in range(len(case.store)):
+        for key in list(case.store[s]["paths"]):
+            c = case.copy()
+            del c.store[s]["paths"][key]
+            yield c
+
+
+def shrink(reference, candidate, case, workdir):
+    progress = True
+    while progress:
+        progress = False
+        for smaller in shrink_candidates(case):
+            if differs(reference, candidate, smaller, workdir):
+                case = smaller
+                progress = True
+                break
+    return case
+
+
+def load_engine(path):
+    engine = ctypes.CDLL(path)
+    handle, string, index = ctypes.c_void_p, ctypes.c_char_p, ctypes.c_int
+    signatures = {
+        "DcqlEngineApiVersion": (index, []),
+        "DcqlStoreParse": (handle, [string]),
+        "DcqlStoreFree": (None, [handle]),
+        "DcqlMatchQuery": (handle, [handle, string]),
+        "DcqlMatchFree": (None, [handle]),
+        "DcqlMatchQueryCount": (index, [handle]),
+        "DcqlMatchQueryId": (string, [handle, index]),
+        "DcqlMatchCredentialCount": (index, [handle, index]),
+        "DcqlMatchCredentialId": (string, [handle, index, index]),
+        "DcqlMatchClaimSet": (index, [handle, index, index]),
+        "DcqlMatchClaimCount": (index, [handle, index, index]),
+        "DcqlMatchClaimDisplay": (string, [handle, index, index, index]),
+    }
+    for name, (restype, argtypes) in signatures.items():
+        getattr(engine, name).restype = restype
+        getattr(engine, name).argtypes = argtypes
+    return engine
+
+
+def engine_results(engine, match):
+    """(query id, credential id, claim set, claim displays) of every credential a match holds."""
+    results = []
+    for q in range(engine.DcqlMatchQueryCount(match)):
+        query_id = engine.DcqlMatchQueryId(match, q).decode()
+        for c in range(engine.DcqlMatchCredentialCount(match, q)):
+            displays = [(engine.DcqlMatchClaimDisplay(match, q, c, k) or b"(null)").decode()
+                        for k in range(engine.DcqlMatchClaimCount(match, q, c))]
+            results.append((query_id, engine.DcqlMatchCredentialId(match, q, c).decode(),
+                            engine.DcqlMatchClaimSet(match, q, c), displays))
+    return results
+
+
+def run_engine(engine, store, dcql_query):
+    match = engine.DcqlMatchQuery(store, json.dumps(dcql_query).encode())
+    try:
+        return engine_results(engine, match)
+    finally:
+        engine.DcqlMatchFree(match)
+
+
+def matcher_entries(calls):
+    """(credential id, query id, claim displays) of the entries a matcher added."""
+    entries = []
+    for call in calls:
+        fields = call.split("\t")
+        if fields[0] == "AddStringIdEntry":
+            _, credential_id, query_id = ast.literal_eval(fields[1])
+            entries.append((credential_id, query_id, []))
+        elif fields[0] == "AddFieldForStringIdEntry":
+            entries[-1][2].append(fields[2])
+    return entries
+
+
+def engine_differences(engine, matcher, case, workdir):
+    """Runs the first request of the case through the engine and the matcher. Returns what differs,
+    or what the engine got wrong on its own."""
+    dcql_query = case.requests[0]["dcql_query"]
+    registry = build_registry(case.store)
+    offset = struct.unpack_from("<i", registry)[0]
+    store = engine.DcqlStoreParse(registry[offset:].rstrip(b"\0"))
+    problems = []
+    try:
+        # Matches are independent of each other: a second one is made while the first is alive, a
+        # store is parsed with the regular allocator in between, and the second one still reads
+        # the same once the first and its arena are gone.
+        query = json.dumps(dcql_query).encode()
+        first = engine.DcqlMatchQuery(store, query)
+        second = engine.DcqlMatchQuery(store, query)
+        other = engine.DcqlStoreParse(registry[offset:].rstrip(b"\0"))
+        results = engine_results(engine, first)
+        engine.DcqlMatchFree(first)
+        if engine_results(engine, second) != results:
+            problems.append("a match changed when another one was freed")
+        engine.DcqlMatchFree(second)
+        engine.DcqlStoreFree(other)
+
+        # Members the engine ignores only add to the arena, past the size of one chunk.
+        padded = copy.deepcopy(dcql_query)
+        padded["padding"] = "x" * 40000
+        if run_engine(engine, store, padded) != results:
+            problems.append("an unknown member changed the result")
+
+        # The claim set of a credential is the first one it satisfies: it still matches with that
+        # claim set alone, and not with the ones before it.
+        queries = {q["id"]: q for q in dcql_query["credentials"]}
+        for query_id, credential_id, claim_set, displays in results:
+            claim_sets = queries[query_id].get("claim_sets")
+            if claim_sets is None:
+                if claim_set != -1:
+                    problems.append("%s got claim set %d without claim sets" % (credential_id, claim_set))
+                continue
+            if not 0 <= claim_set < len(claim_sets):
+                problems.append("%s got claim set %d of %d" % (credential_id, claim_set, len(claim_sets)))
+                continue
+            for kept, expected in ((claim_sets[claim_set:claim_set + 1], True), (claim_sets[:claim_set], False)):
+                if not kept:
+                    continue
+                narrowed = copy.deepcopy(dcql_query)
+                [q for q in narrowed["credentials"] if q["id"] == query_id][0]["claim_sets"] = kept
+                found = any(r[:2] == (query_id, credential_id) and r[3] == displays
+                            for r in run_engine(engine, store, narrowed))
+                if found != expected:
+                    problems.append("%s %s claim sets %r" % (credential_id, "misses" if expected else "matches", kept))
+    finally:
+        engine.DcqlStoreFree(store)
+
+    # The matcher adds a credential once for every distinct set of claims, see entry_dedup.h.
+    expected, seen = [], set()
+    for query_id, credential_id, _, displays in results:
+        if (credential_id, frozenset(displays)) not in seen:
+            seen.add((credential_id, frozenset(displays)))
+            expected.append((credential_id, query_id, displays))
+    entries = matcher_entries(run_matcher(matcher, case, workdir))
+    if entries != expected:
+        problems.append("matcher %r\nengine  %r" % (entries, expected))
+    return problems
+
+
+def engine_test(args, workdir):
+    engine = load_engine(os.path.abspath(args.engine))
+    if engine.DcqlEngineApiVersion() != 1:
+        print("unexpected engine API version %d" % engine.DcqlEngineApiVersion())
+        return 1
+    if engine.DcqlStoreParse(b"{") is not None or engine.DcqlMatchQuery(None, b"{") is not None:
+        print("the engine accepted malformed json")
+        return 1
+    engine.DcqlStoreFree(None)
+    engine.DcqlMatchFree(None)
+
+    matcher = build_matcher(args.candidate_rev, "openid4vp1_0", workdir, "candidate", args.candidate_cflags.split())
+    rng = random.Random(args.seed)
+    for n in range(args.cases):
+        case = gen_case(rng, "openid4vp1_0")
+        # The engine only matches the DCQL query, the rest of the request stays with the matcher.
+        case.requests = [{"protocol": "openid4vp-v1-unsigned", "dcql_query": case.requests[0]["dcql_query"]}]
+        problems = engine_differences(engine, matcher, case, workdir)
+        if not problems:
+            continue
+        print("case %d differs\n%s" % (n, "\n".join(problems)))
+        os.makedirs(args.out, exist_ok=True)
+        with open(os.path.join(args.out, "request.json"), "wb") as f:
+            f.write(build_request(case))
+        with open(os.path.join(args.out, "testcreds.json"), "wb") as f:
+            f.write(build_registry(case.store))
+        print("case written to %s" % args.out)
+        return 1
+    print("%d cases, no differences" % args.cases)
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--matcher", choices=sorted(MATCHERS), default="openid4vp1_0")
+    parser.add_argument("--reference-rev", default="HEAD", help="git revision of the legacy matcher")
+    parser.add_argument("--candidate-rev", default=None, help="git revision of the new matcher (default: working tree)")
+    parser.add_argument("--candidate-cflags", default="", help="extra compiler flags for the candidate, e.g. -DCREDMAN_BATCH")
+    parser.add_argument("--cases", type=int, default=200)
+    parser.add_argument("--seed", type=int, default=0)
+    parser.add_argument("--out", default="difftest_failure")
+    parser.add_argument("--legacy-registry", action="store_true", help="write icons inline in each credential")
+    parser.add_argument("--engine", default=None, help="test this host build of the DCQL engine instead")
+    args = parser.parse_args()
+    global LEGACY_REGISTRY
+    LEGACY_REGISTRY = args.legacy_registry
+
+    workdir = tempfile.mkdtemp(prefix="difftest")
+    try:
+        if args.engine is not None:
+            return engine_test(args, workdir)
+        reference = build_matcher(args.reference_rev, args.matcher, workdir, "reference")
+        candidate = build_matcher(args.candidate_rev, args.matcher, workdir, "candidate", args.candidate_cflags.split())
+        rng = random.Random(args.seed)
+        for n in range(args.cases):
+            case = gen_case(rng, args.matcher)
+            if not differs(reference, candidate, case, workdir):
+                continue
+            print("case %d differs, shrinking" % n)
+            case = shrink(reference, candidate, case, workdir)
+            os.makedirs(args.out, exist_ok=True)
+            with open(os.path.join(args.out, "request.json"), "wb") as f:
+                f.write(build_request(case))
+            with open(os.path.join(args.out, "testcreds.json"), "wb") as f:
+                f.write(build_registry(case.store))
+            diff = difflib.unified_diff(run_matcher(reference, case, workdir), run_matcher(candidate, case, workdir),
+                                        "reference", "candidate", lineterm="")
+            print("\n".join(diff))
+            print("minimal case written to %s" % args.out)
+            return 1
+        print("%d cases, no differences" % args.cases)
+        return 0
+    finally:
+        shutil.rmtree(workdir)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
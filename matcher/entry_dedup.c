@@ -0,0 +1,148 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "entry_dedup.h"
+#include "hash.h"
+
+// Keys are the credential id, the values and the sorted, distinct fields, each NUL terminated,
+// followed by the number of values as a u32. A NULL string is the byte 0xff, which no UTF-8 string
+// has, so different keys never share bytes.
+#define KEY_NULL 0xff
+
+// Seen keys live in an open addressing table with linear probing. The table and the keys are
+// allocated from an arena that lasts as long as the matcher, nothing is removed from the set.
+#define SEEN_INITIAL_CAPACITY 64
+#define ARENA_CHUNK_SIZE 4096
+
+typedef struct SeenKey {
+    uint32_t hash;
+    uint32_t len;
+    const char* bytes; // NULL for an empty slot
+} SeenKey;
+
+static SeenKey* seen;
+static uint32_t seen_size;
+static uint32_t seen_capacity;
+
+static char* arena;
+static size_t arena_used;
+static size_t arena_cap;
+
+// The key being built, reused for every entry.
+static uint32_t key_values;
+static const char** key_fields;
+static int key_fields_size;
+static int key_fields_capacity;
+static char* key;
+static size_t key_len;
+static size_t key_capacity;
+
+static void* ArenaMalloc(size_t size) {
+    size = (size + 7) & ~(size_t)7;
+    if (arena == NULL || arena_used + size > arena_cap) {
+        // The rest of the previous chunk is left unused
+        arena_cap = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+        arena = malloc(arena_cap);
+        arena_used = 0;
+    }
+    void* p = arena + arena_used;
+    arena_used += size;
+    return p;
+}
+
+static void AppendKey(const void* bytes, size_t len) {
+    if (key_len + len > key_capacity) {
+        key_capacity = key_len + len > 2 * key_capacity ? key_len + len : 2 * key_capacity;
+        key = realloc(key, key_capacity);
+    }
+    memcpy(key + key_len, bytes, len);
+    key_len += len;
+}
+
+static void AppendKeyString(const char* value) {
+    if (value == NULL) {
+        uint8_t null = KEY_NULL;
+        AppendKey(&null, 1);
+        AppendKey("", 1);
+    } else {
+        AppendKey(value, strlen(value) + 1);
+    }
+}
+
+static int CompareFields(const void* a, const void* b) {
+    const char* x = *(const char* const*)a;
+    const char* y = *(const char* const*)b;
+    if (x == NULL || y == NULL) {
+        return (x != NULL) - (y != NULL);
+    }
+    return strcmp(x, y);
+}
+
+static void GrowSeen() {
+    SeenKey* old = seen;
+    uint32_t old_capacity = seen_capacity;
+    seen_capacity = old_capacity == 0 ? SEEN_INITIAL_CAPACITY : 2 * old_capacity;
+    seen = ArenaMalloc(seen_capacity * sizeof(SeenKey));
+    memset(seen, 0, seen_capacity * sizeof(SeenKey));
+    for (uint32_t i = 0; i < old_capacity; i++) {
+        if (old[i].bytes != NULL) {
+            uint32_t slot = old[i].hash & (seen_capacity - 1);
+            while (seen[slot].bytes != NULL) {
+                slot = (slot + 1) & (seen_capacity - 1);
+            }
+            seen[slot] = old[i];
+        }
+    }
+}
+
+void EntryKeyStart(const char* cred_id) {
+    key_len = 0;
+    key_values = 0;
+    key_fields_size = 0;
+    AppendKeyString(cred_id);
+}
+
+void EntryKeyAddValue(const char* value) {
+    AppendKeyString(value);
+    key_values++;
+}
+
+void EntryKeyAddField(const char* field) {
+    if (key_fields_size == key_fields_capacity) {
+        key_fields_capacity = key_fields_capacity == 0 ? 16 : 2 * key_fields_capacity;
+        key_fields = realloc(key_fields, key_fields_capacity * sizeof(const char*));
+    }
+    key_fields[key_fields_size++] = field;
+}
+
+int EntryKeyIsNew() {
+    if (key_fields_size > 1) {
+        qsort(key_fields, key_fields_size, sizeof(const char*), CompareFields);
+    }
+    for (int i = 0; i < key_fields_size; i++) {
+        if (i == 0 || CompareFields(&key_fields[i - 1], &key_fields[i]) != 0) {
+            AppendKeyString(key_fields[i]);
+        }
+    }
+    AppendKey(&key_values, sizeof(key_values));
+
+    uint32_t hash = HashBytes(key, key_len);
+    if (2 * (seen_size + 1) > seen_capacity) {
+        GrowSeen();
+    }
+    uint32_t slot = hash & (seen_capacity - 1);
+    while (seen[slot].bytes != NULL) {
+        if (seen[slot].hash == hash && seen[slot].len == key_len && memcmp(seen[slot].bytes, key, key_len) == 0) {
+            return 0;
+        }
+        slot = (slot + 1) & (seen_capacity - 1);
+    }
+    char* bytes = ArenaMalloc(key_len);
+    memcpy(bytes, key, key_len);
+    seen[slot].hash = hash;
+    seen[slot].len = (uint32_t)key_len;
+    seen[slot].bytes = bytes;
+    seen_size++;
+    return 1;
+}
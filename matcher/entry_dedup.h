@@ -0,0 +1,31 @@
+#ifndef ENTRY_DEDUP_H
+#define ENTRY_DEDUP_H
+
+// Duplicate suppression for the entries of the openid4vp matchers. A stored credential matched by
+// several credential queries, or by the same query sent under several protocols, would otherwise
+// be added once per match and show up in the selector as many times.
+//
+// An entry is keyed on its credential id, the set of fields it shows, in any order, and whatever
+// else of it differs between matches, like the payment of a payment entry. The first entry added
+// for a key is kept, it answers the earliest request and credential query, and later ones are
+// dropped. Matches of one credential that show other fields stay separate entries.
+//
+//     EntryKeyStart(cred_id);
+//     EntryKeyAddValue(value); ...
+//     EntryKeyAddField(field); ...
+//     if (EntryKeyIsNew()) { add the entry }
+//
+// NULL is a value or field of its own.
+
+void EntryKeyStart(const char* cred_id);
+
+// Values are compared in the order they are added.
+void EntryKeyAddValue(const char* value);
+
+// field has to stay valid until EntryKeyIsNew.
+void EntryKeyAddField(const char* field);
+
+// Returns 1 and remembers the key if no entry was added for it before, 0 otherwise.
+int EntryKeyIsNew();
+
+#endif
@@ -0,0 +1,51 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "base64.h"
+#include "entry_id.h"
+
+static size_t PutVarint(uint8_t* out, uint32_t value) {
+    size_t len = 0;
+    while (value >= 0x80) {
+        out[len++] = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    out[len++] = value;
+    return len;
+}
+
+static size_t PutString(uint8_t* out, const char* value, size_t len) {
+    size_t prefix = PutVarint(out, len);
+    if (len > 0) {
+        memcpy(out + prefix, value, len);
+    }
+    return prefix + len;
+}
+
+char* EncodeEntryId(char buffer[ENTRY_ID_BUFFER_SIZE], const char* cred_id, const char* dcql_cred_id, uint32_t request_idx) {
+    size_t cred_id_len = cred_id != NULL ? strlen(cred_id) : 0;
+    size_t dcql_cred_id_len = dcql_cred_id != NULL ? strlen(dcql_cred_id) : 0;
+    // Version, then at most 5 bytes for each varint.
+    size_t max_raw_len = 1 + 5 + 5 + cred_id_len + 5 + dcql_cred_id_len;
+
+    uint8_t raw_buffer[(ENTRY_ID_BUFFER_SIZE - 1) * 3 / 4];
+    uint8_t* raw = raw_buffer;
+    char* id = buffer;
+    if ((max_raw_len * 4 + 2) / 3 + 1 > ENTRY_ID_BUFFER_SIZE) {
+        raw = malloc(max_raw_len);
+        id = malloc((max_raw_len * 4 + 2) / 3 + 1);
+    }
+
+    size_t raw_len = 0;
+    raw[raw_len++] = ENTRY_ID_VERSION;
+    raw_len += PutVarint(raw + raw_len, request_idx);
+    raw_len += PutString(raw + raw_len, cred_id, cred_id_len);
+    raw_len += PutString(raw + raw_len, dcql_cred_id, dcql_cred_id_len);
+    B64EncodeURLNoPadding(raw, raw_len, id);
+
+    if (raw != raw_buffer) {
+        free(raw);
+    }
+    return id;
+}
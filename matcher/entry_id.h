@@ -0,0 +1,27 @@
+#ifndef ENTRY_ID_H
+#define ENTRY_ID_H
+
+#include <stdint.h>
+
+// Entry ids of the openid4vp matchers, decoded by EntryId.decode in GetCredentialActivity.kt.
+// The id is the unpadded base64url encoding of:
+//
+// |---------------------------------------|
+// |------------ (u8) version -------------|
+// |------- (varint) request index --------|
+// |--- (varint) length, credential id ----|
+// |- (varint) length, dcql credential id -|
+// |---------------------------------------|
+//
+// Varints are unsigned LEB128. Ids used to be json objects, which always start with '{' while an
+// encoded id never does.
+
+#define ENTRY_ID_VERSION 1
+#define ENTRY_ID_BUFFER_SIZE 256
+
+// Encodes the id of a matched credential into buffer. Ids that don't fit ENTRY_ID_BUFFER_SIZE
+// bytes are allocated instead and have to be freed by the caller when the result is not buffer.
+// A NULL cred_id or dcql_cred_id is encoded as an empty string.
+char* EncodeEntryId(char buffer[ENTRY_ID_BUFFER_SIZE], const char* cred_id, const char* dcql_cred_id, uint32_t request_idx);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// 32-bit FNV-1a, used for the lookup tables of the matchers. The registry writer in the app uses
+// the same function where it precomputes hashes, so keep the two in sync.
+#define HASH_FNV_OFFSET 2166136261u
+#define HASH_FNV_PRIME 16777619u
+
+static inline uint32_t HashBytes(const void* bytes, size_t len) {
+    uint32_t hash = HASH_FNV_OFFSET;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= ((const uint8_t*)bytes)[i];
+        hash *= HASH_FNV_PRIME;
+    }
+    return hash;
+}
+
+static inline uint32_t HashString(const char* value) {
+    uint32_t hash = HASH_FNV_OFFSET;
+    for (const char* c = value; *c != '\0'; c++) {
+        hash ^= (uint8_t)*c;
+        hash *= HASH_FNV_PRIME;
+    }
+    return hash;
+}
+
+// Hash lists are how the registry stores sets of strings that are only ever tested for
+// membership: the hashes of the strings as 8 lowercase hex digits each, in ascending order and
+// concatenated into one json string. They are binary searched in place.
+#define HASH_HEX_LEN 8
+
+static inline void HashToHex(uint32_t hash, char hex[HASH_HEX_LEN]) {
+    for (int i = 0; i < HASH_HEX_LEN; i++) {
+        hex[i] = "0123456789abcdef"[(hash >> (28 - 4 * i)) & 0xf];
+    }
+}
+
+// The index of hex in the list of len characters, or -1 if it isn't there. Callers searching the
+// same list for several values measure it once.
+static inline int HashListFind(const char* list, size_t len, const char hex[HASH_HEX_LEN]) {
+    size_t low = 0;
+    size_t high = list != NULL ? len / HASH_HEX_LEN : 0;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        int cmp = memcmp(list + mid * HASH_HEX_LEN, hex, HASH_HEX_LEN);
+        if (cmp == 0) {
+            return (int)mid;
+        }
+        if (cmp < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return -1;
+}
+
+#endif
@@ -6,17 +6,21 @@
 #include <unistd.h>
 #include "../cJSON/cJSON.h"
 #include "../credentialmanager.h"
+#include "../debug.h"
+#include "../hash.h"
+#include "../request_scan.h"
 
 #include "launcher_icon.h"
 
 #define PROTOCOL_OPENID4VCI "openid4vci1.0"
 
-cJSON* GetDCRequestJson() {
+char* GetDCRequest(size_t* request_len) {
     uint32_t request_size;
     GetRequestSize(&request_size);
     char* request_json = malloc(request_size);
     GetRequestBuffer(request_json);
-    return cJSON_Parse(request_json);
+    *request_len = strnlen(request_json, request_size);
+    return request_json;
 }
 
 cJSON* GetCredsJson() {
@@ -27,6 +31,47 @@ cJSON* GetCredsJson() {
     return cJSON_Parse(creds_json);
 }
 
+// Whether the offer is for any credential configuration the wallet can be provisioned with by its
+// issuer. The issuers are a hash list, see hash.h, and the configuration ids of the i-th are the
+// hash list at index i of "configuration_ids", null if the wallet takes any configuration of it. Registries written before list the issuers as
+// keys of the capabilities object and accept any configuration.
+static int OfferSupported(cJSON* capabilities, cJSON* cred_offer) {
+    char* credential_issuer = cJSON_GetStringValue(cJSON_GetObjectItem(cred_offer, "credential_issuer"));
+    char* issuer_hashes = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(capabilities, "issuer_hashes"));
+    if (issuer_hashes == NULL) {
+        return cJSON_HasObjectItem(capabilities, credential_issuer);
+    }
+    if (credential_issuer == NULL) {
+        return 0;
+    }
+    char hex[HASH_HEX_LEN];
+    HashToHex(HashString(credential_issuer), hex);
+    int issuer_index = HashListFind(issuer_hashes, strlen(issuer_hashes), hex);
+    if (issuer_index < 0) {
+        return 0;
+    }
+    cJSON* issuer_ids = cJSON_GetArrayItem(cJSON_GetObjectItemCaseSensitive(capabilities, "configuration_ids"), issuer_index);
+    if (cJSON_IsNull(issuer_ids)) {
+        return 1;
+    }
+    char* configuration_ids = cJSON_GetStringValue(issuer_ids);
+    if (configuration_ids == NULL) {
+        return 0;
+    }
+    // Searched once per offered id
+    size_t configuration_ids_len = strlen(configuration_ids);
+    cJSON* offered_id;
+    cJSON_ArrayForEach(offered_id, cJSON_GetObjectItem(cred_offer, "credential_configuration_ids")) {
+        if (cJSON_IsString(offered_id)) {
+            HashToHex(HashString(cJSON_GetStringValue(offered_id)), hex);
+            if (HashListFind(configuration_ids, configuration_ids_len, hex) >= 0) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
 int main() {uint32_t credentials_size;
     GetCredentialsSize(&credentials_size);
 
@@ -34,10 +79,10 @@ int main() {uint32_t credentials_size;
     ReadCredentialsBuffer(creds_blob, 0, credentials_size);
 
     int json_offset = *((int*)creds_blob);
-    printf("Creds JSON offset %d\n", json_offset);
+    DEBUG_LOG("Creds JSON offset %d\n", json_offset);
 
     cJSON* creds = cJSON_Parse(creds_blob + json_offset);
-    printf("Creds JSON %s\n", cJSON_Print(creds));
+    DEBUG_LOG("Creds JSON %s\n", cJSON_Print(creds));
     /* 
       {
         "display": {
@@ -45,28 +90,26 @@ int main() {uint32_t credentials_size;
             "title": "...",
             "subtitle": "..."
         },
-        capability: {
-            "issuer1": {},
-            "issuer2": {}
+        "capabilities": {
+            "issuer_hashes": "<hash of issuer1><hash of issuer2>",
+            "configuration_ids": ["<hashes of the ids for issuer1>", null for any of issuer2, ...]
         }
       }
     */
 
-    cJSON* dc_request = GetDCRequestJson();
-    printf("Request JSON %s\n", cJSON_Print(dc_request));
+    size_t request_len;
+    char* dc_request = GetDCRequest(&request_len);
+    DEBUG_LOG("Request JSON %.*s\n", (int)request_len, dc_request);
 
-    cJSON* requests = cJSON_GetObjectItem(dc_request, "requests");
-    int requests_size = cJSON_GetArraySize(requests);
+    ScannedRequest* requests;
+    int requests_size = ScanRequests(dc_request, request_len, &requests);
     for(int i=0; i<requests_size; i++) {
-        cJSON* request = cJSON_GetArrayItem(requests, i);
-        char* protocol = cJSON_GetStringValue(cJSON_GetObjectItem(request, "protocol"));
-        if (strcmp(protocol, PROTOCOL_OPENID4VCI) == 0) {
+        if (SpanIsString(requests[i].protocol, PROTOCOL_OPENID4VCI)) {
             // We have an OpenID4VCI request
-            cJSON* cred_offer = cJSON_GetObjectItem(request, "data");
-            cJSON* credential_issuer = cJSON_GetObjectItem(cred_offer, "credential_issuer");
-        
+            cJSON* cred_offer = ParseRequestData(requests[i].data);
+
             cJSON* capabilities = cJSON_GetObjectItem(creds, "capabilities");
-            if(cJSON_HasObjectItem(capabilities, cJSON_GetStringValue(credential_issuer))) {
+            if(OfferSupported(capabilities, cred_offer)) {
                 cJSON* display = cJSON_GetObjectItem(creds, "display");
                 cJSON* icon = cJSON_GetObjectItem(display, "icon");
                 int icon_start_int = 0;
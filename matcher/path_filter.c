@@ -0,0 +1,119 @@
+#include <stdlib.h>
+#include <strings.h>
+
+#include "hash.h"
+#include "path_filter.h"
+
+static int HashClaimPath(const cJSON* path, uint32_t* hash) {
+    if (cJSON_GetArraySize(path) == 0) {
+        return 0;
+    }
+    uint32_t h = HASH_FNV_OFFSET;
+    cJSON* component;
+    cJSON_ArrayForEach(component, path) {
+        if (!cJSON_IsString(component)) {
+            return 0;
+        }
+        for (const char* c = component->valuestring; *c != '\0'; c++) {
+            h ^= (uint8_t)*c;
+            h *= HASH_FNV_PRIME;
+        }
+        h *= HASH_FNV_PRIME; // the zero byte separating components
+    }
+    *hash = h;
+    return 1;
+}
+
+static int FilterMayContain(const uint32_t* filter, uint32_t words, uint32_t hash) {
+    uint32_t bits = words * 32;
+    uint32_t step = ((hash >> 16) | (hash << 16)) | 1;
+    for (uint32_t i = 0; i < PATH_FILTER_HASHES; i++) {
+        uint32_t bit = (hash + i * step) % bits;
+        if ((filter[bit / 32] & (1u << (bit % 32))) == 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void PlanClaims(cJSON* claims, cJSON* claim_sets, ClaimPlan* plan) {
+    plan->claims = claims;
+    plan->claim_sets = claim_sets;
+    plan->count = cJSON_GetArraySize(claims);
+    int size = plan->count > 0 ? plan->count : 1;
+    plan->hashes = malloc(sizeof(uint32_t) * size);
+    plan->checkable = malloc(size);
+    plan->absent = malloc(size);
+    int i = 0;
+    cJSON* claim;
+    cJSON_ArrayForEach(claim, claims) {
+        plan->checkable[i] = HashClaimPath(cJSON_GetObjectItemCaseSensitive(claim, "path"), &plan->hashes[i]);
+        i++;
+    }
+}
+
+// Whether some claim with the id of claim set member id, compared as dcql.c does, may resolve.
+static int ClaimIdMayMatch(const ClaimPlan* plan, const char* id) {
+    if (id == NULL) {
+        return 0;
+    }
+    int i = 0;
+    cJSON* claim;
+    cJSON_ArrayForEach(claim, plan->claims) {
+        char* claim_id = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(claim, "id"));
+        if (!plan->absent[i] && claim_id != NULL && strcasecmp(claim_id, id) == 0) {
+            return 1;
+        }
+        i++;
+    }
+    return 0;
+}
+
+int ClaimPlanMayMatch(const ClaimPlan* plan, StoreRef candidate) {
+    StoreRef filter_json = StoreGetObjectItemCaseSensitive(candidate, "path_filter");
+    uint32_t words = StoreGetArraySize(filter_json);
+    if (words == 0 || words > PATH_FILTER_MAX_WORDS) {
+        return 1;
+    }
+    uint32_t filter[PATH_FILTER_MAX_WORDS];
+    uint32_t w = 0;
+    StoreRef word;
+    StoreArrayForEach(word, filter_json) {
+        if (!StoreIsNumber(word)) {
+            return 1;
+        }
+        filter[w++] = (uint32_t)StoreGetNumberValue(word);
+    }
+    int any_absent = 0;
+    for (int i = 0; i < plan->count; i++) {
+        plan->absent[i] = plan->checkable[i] && !FilterMayContain(filter, words, plan->hashes[i]);
+        any_absent |= plan->absent[i];
+    }
+    if (!any_absent) {
+        return 1;
+    }
+    if (plan->claim_sets == NULL) {
+        return 0;
+    }
+    cJSON* claim_set;
+    cJSON_ArrayForEach(claim_set, plan->claim_sets) {
+        int set_may_match = 1;
+        cJSON* id;
+        cJSON_ArrayForEach(id, claim_set) {
+            if (!ClaimIdMayMatch(plan, cJSON_GetStringValue(id))) {
+                set_may_match = 0;
+                break;
+            }
+        }
+        if (set_may_match) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void FreeClaimPlan(ClaimPlan* plan) {
+    free(plan->hashes);
+    free(plan->checkable);
+    free(plan->absent);
+}
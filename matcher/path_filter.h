@@ -0,0 +1,37 @@
+#ifndef PATH_FILTER_H
+#define PATH_FILTER_H
+
+#include <stdint.h>
+
+#include "cJSON/cJSON.h"
+#include "store.h"
+
+// Bloom filter over the claim paths of a registry credential, written by the registry encoder as
+// its "path_filter" array of u32 words. It holds every member path under the credential's
+// "paths", at any depth, so a claim path missing from the filter can't resolve.
+//
+// A path hashes as FNV-1a over its components, each followed by a zero byte. The bits of a path
+// are (hash + i * step) mod (32 * words) for i < PATH_FILTER_HASHES, with step the hash rotated by
+// 16 bits and its lowest bit set.
+#define PATH_FILTER_HASHES 3
+#define PATH_FILTER_MAX_WORDS 64 // larger filters are ignored
+
+// The claims of a credential query, hashed once for checking any number of candidates.
+typedef struct ClaimPlan {
+    cJSON* claims;
+    cJSON* claim_sets;
+    int count;
+    uint32_t* hashes;
+    uint8_t* checkable; // 0 for paths with non-string components, they are left to the matcher
+    uint8_t* absent;    // scratch, per candidate
+} ClaimPlan;
+
+void PlanClaims(cJSON* claims, cJSON* claim_sets, ClaimPlan* plan);
+
+// Returns 0 if the path filter of candidate rules it out for the planned claims, or claim_sets
+// when there are some. Candidates without a filter may always match.
+int ClaimPlanMayMatch(const ClaimPlan* plan, StoreRef candidate);
+
+void FreeClaimPlan(ClaimPlan* plan);
+
+#endif
@@ -1,22 +1,24 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "../base64.h"
 #include "../dcql.h"
+#include "../hash.h"
+#include "../path_filter.h"
 
 #include "../cJSON/cJSON.h"
 
-int AddAllClaims(cJSON *matched_claim_names, cJSON *candidate_paths)
+int AddAllClaims(cJSON *matched_claim_names, StoreRef candidate_paths)
 {
-    cJSON *curr_path;
-    cJSON_ArrayForEach(curr_path, candidate_paths)
+    StoreRef curr_path;
+    StoreArrayForEach(curr_path, candidate_paths)
     {
-        cJSON *attr;
-        if (cJSON_HasObjectItem(curr_path, "display"))
+        if (StoreHasObjectItem(curr_path, "display"))
         {
-            cJSON_AddItemReferenceToArray(matched_claim_names, cJSON_GetObjectItem(curr_path, "display"));
+            StoreAddItemToArray(matched_claim_names, StoreGetObjectItem(curr_path, "display"));
         }
-        else if (cJSON_IsObject(curr_path))
+        else if (StoreIsObject(curr_path))
         {
             AddAllClaims(matched_claim_names, curr_path);
         }
@@ -24,277 +26,352 @@ int AddAllClaims(cJSON *matched_claim_names, cJSON *candidate_paths)
     return 0;
 }
 
-cJSON *MatchCredential(cJSON *credential, cJSON *credential_store)
+// Whether the claim resolves under the candidate's paths to one of the requested values.
+static int MatchClaim(StoreRef candidate_claims, cJSON *claim)
 {
-    cJSON *matched_credentials = cJSON_CreateArray();
-    char *format = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(credential, "format"));
+    cJSON *claim_values = cJSON_GetObjectItemCaseSensitive(claim, "values");
+    cJSON *paths = cJSON_GetObjectItemCaseSensitive(claim, "path");
+    cJSON *curr_path;
+    StoreRef curr_claim = candidate_claims;
+    cJSON_ArrayForEach(curr_path, paths)
+    {
+        char *path_value = cJSON_GetStringValue(curr_path);
+        if (StoreHasObjectItem(curr_claim, path_value))
+        {
+            curr_claim = StoreGetObjectItemCaseSensitive(curr_claim, path_value);
+        }
+        else
+        {
+            return 0;
+        }
+    }
+    if (curr_claim == NULL)
+    {
+        return 0;
+    }
+    if (claim_values != NULL)
+    {
+        cJSON *v;
+        cJSON_ArrayForEach(v, claim_values)
+        {
+            if (StoreCompare(v, StoreGetObjectItemCaseSensitive(curr_claim, "value")))
+            {
+                return 1;
+            }
+        }
+        return 0;
+    }
+    return 1;
+}
 
-    // check for optional params
-    cJSON *meta = cJSON_GetObjectItemCaseSensitive(credential, "meta");
-    cJSON *claims = cJSON_GetObjectItemCaseSensitive(credential, "claims");
-    cJSON *claim_sets = cJSON_GetObjectItemCaseSensitive(credential, "claim_sets");
+// The claims of a credential_authorization_jwt used for matching. Verifiers send the same JWT
+// with each of their phone number queries, it is decoded once per run. Everything is copied out
+// of the query and the decoded json, which may not outlive the query's dcql_query call.
+typedef struct CredentialAuthorization
+{
+    uint32_t hash;
+    char *jwt;
+    int has_iss;
+    char *iss;
+    char iss_hash[HASH_HEX_LEN]; // when iss is not NULL, see IssAllowed
+    char *consent;
+    char *policy_url;
+    char *policy_text;
+} CredentialAuthorization;
 
-    cJSON *candidates = cJSON_GetObjectItemCaseSensitive(credential_store, format);
+static CredentialAuthorization *authorizations;
+static int authorizations_size;
+static int authorizations_capacity;
 
-    if (candidates == NULL)
+static char *CopyString(const char *value)
+{
+    if (value == NULL)
     {
-        return matched_credentials;
+        return NULL;
     }
+    size_t len = strlen(value) + 1;
+    return memcpy(malloc(len), value, len);
+}
 
-    // Filter by meta
-    cJSON *aggregator_consent = NULL;
-    cJSON *aggregator_policy_url = NULL;
-    cJSON *aggregator_policy_text = NULL;
-    if (meta != NULL)
+// Decodes the base64url segment of len bytes at segment and parses it as json.
+static cJSON *ParseJwtSegment(const char *segment, size_t len)
+{
+    char *encoded = malloc(len + 1);
+    memcpy(encoded, segment, len);
+    encoded[len] = '\0';
+    char *decoded;
+    B64DecodeURL(encoded, &decoded);
+    free(encoded);
+    cJSON *json = cJSON_Parse(decoded);
+    free(decoded);
+    return json;
+}
+
+static void DecodeCredentialAuthorization(CredentialAuthorization *authorization)
+{
+    const char *payload_start = authorization->jwt != NULL ? strchr(authorization->jwt, '.') : NULL;
+    if (payload_start == NULL)
+    {
+        return;
+    }
+    payload_start++;
+    const char *payload_end = strchr(payload_start, '.');
+    if (payload_end == NULL)
+    {
+        payload_end = payload_start + strlen(payload_start);
+    }
+    cJSON *cred_auth_json = ParseJwtSegment(payload_start, payload_end - payload_start);
+    authorization->has_iss = cJSON_HasObjectItem(cred_auth_json, "iss");
+    authorization->iss = CopyString(cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(cred_auth_json, "iss")));
+    if (authorization->iss != NULL)
+    {
+        HashToHex(HashString(authorization->iss), authorization->iss_hash);
+    }
+    char *consent_data = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(cred_auth_json, "consent_data"));
+    if (cJSON_HasObjectItem(cred_auth_json, "consent_data") && consent_data != NULL)
+    {
+        cJSON *consent_data_json = ParseJwtSegment(consent_data, strlen(consent_data));
+        authorization->consent = CopyString(cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(consent_data_json, "consent_text")));
+        authorization->policy_url = CopyString(cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(consent_data_json, "policy_link")));
+        authorization->policy_text = CopyString(cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(consent_data_json, "policy_text")));
+        cJSON_Delete(consent_data_json);
+    }
+    cJSON_Delete(cred_auth_json);
+}
+
+// Returns the decoded claims of jwt, which is left unchanged. A NULL jwt, or one without a
+// payload, has no iss.
+static const CredentialAuthorization *GetCredentialAuthorization(const char *jwt)
+{
+    uint32_t hash = jwt != NULL ? HashString(jwt) : 0;
+    for (int i = 0; i < authorizations_size; i++)
+    {
+        const char *cached = authorizations[i].jwt;
+        if (authorizations[i].hash == hash && (cached == NULL ? jwt == NULL : jwt != NULL && strcmp(cached, jwt) == 0))
+        {
+            return &authorizations[i];
+        }
+    }
+    if (authorizations_size == authorizations_capacity)
+    {
+        authorizations_capacity = authorizations_capacity == 0 ? 4 : authorizations_capacity * 2;
+        authorizations = realloc(authorizations, sizeof(CredentialAuthorization) * authorizations_capacity);
+    }
+    CredentialAuthorization *authorization = &authorizations[authorizations_size++];
+    memset(authorization, 0, sizeof(CredentialAuthorization));
+    authorization->hash = hash;
+    authorization->jwt = CopyString(jwt);
+    DecodeCredentialAuthorization(authorization);
+    return authorization;
+}
+
+// Whether the issuer of authorization may request candidate. The registry lists the allowed
+// issuers as an "iss_allowlist" object keyed by issuer, which decides. Registries since also list
+// them as "iss_allowlist_hashes", a hash list, see hash.h, which rules out most other issuers with
+// a binary search. FNV-1a collides easily, so a hash in the list is only confirmed by the object
+// and a list without the object allows no issuer. Candidates without either allow all issuers.
+static int IssAllowed(StoreRef candidate, const CredentialAuthorization *authorization)
+{
+    const char *hashes = StoreGetStringValue(StoreGetObjectItemCaseSensitive(candidate, "iss_allowlist_hashes"));
+    StoreRef iss_allowlist = StoreGetObjectItemCaseSensitive(candidate, "iss_allowlist");
+    if (hashes == NULL && iss_allowlist == NULL)
+    {
+        return 1;
+    }
+    if (authorization->iss == NULL || iss_allowlist == NULL)
+    {
+        return 0;
+    }
+    if (hashes != NULL && HashListFind(hashes, strlen(hashes), authorization->iss_hash) < 0)
+    {
+        return 0;
+    }
+    return StoreGetObjectItemCaseSensitive(iss_allowlist, authorization->iss) != NULL;
+}
+
+// Adds value to object without copying it, nothing if it is NULL.
+static void AddStringReference(cJSON *object, const char *key, const char *value)
+{
+    if (value != NULL)
+    {
+        cJSON_AddItemToObject(object, key, cJSON_CreateStringReference(value));
+    }
+}
+
+// A credential query as its candidates are matched against it, and where the matches go.
+typedef struct CandidateQuery
+{
+    cJSON *claims;
+    cJSON *claim_sets;
+    ClaimPlan plan; // when there are claims
+    const char *aggregator_consent;
+    const char *aggregator_policy_url;
+    const char *aggregator_policy_text;
+    cJSON *matched_credentials;
+    int matched; // size of matched_credentials, for MATCHER_ENTRY_LIMIT
+} CandidateQuery;
+
+static void MatchCandidate(CandidateQuery *query, StoreRef candidate)
+{
+    if (query->claims != NULL && !ClaimPlanMayMatch(&query->plan, candidate))
     {
-        if (strcmp(format, "dc-authorization+sd-jwt") == 0)
+        return;
+    }
+    cJSON *matched_credential = cJSON_CreateObject();
+    StoreAddItemToObject(matched_credential, "id", StoreGetObjectItemCaseSensitive(candidate, "id"));
+    StoreAddItemToObject(matched_credential, "title", StoreGetObjectItemCaseSensitive(candidate, "title"));
+    StoreAddItemToObject(matched_credential, "subtitle", StoreGetObjectItemCaseSensitive(candidate, "subtitle"));
+    StoreAddItemToObject(matched_credential, "disclaimer", StoreGetObjectItemCaseSensitive(candidate, "disclaimer"));
+    StoreAddItemToObject(matched_credential, "icon", StoreGetObjectItemCaseSensitive(candidate, "icon"));
+    AddStringReference(matched_credential, "aggregator_consent", query->aggregator_consent);
+    AddStringReference(matched_credential, "aggregator_policy_text", query->aggregator_policy_text);
+    AddStringReference(matched_credential, "aggregator_policy_url", query->aggregator_policy_url);
+    StoreRef candidate_claims = StoreGetObjectItemCaseSensitive(candidate, "paths");
+
+    // Match on the claims
+    if (query->claims == NULL)
+    {
+        // Match every candidate
+        cJSON *matched_claim_names = cJSON_CreateArray();
+        StoreAddItemToArray(matched_claim_names, StoreGetObjectItemCaseSensitive(candidate, "shared_attribute_display_name"));
+        cJSON_AddItemReferenceToObject(matched_credential, "matched_claim_names", matched_claim_names);
+        cJSON_AddItemReferenceToArray(query->matched_credentials, matched_credential);
+        query->matched++;
+    }
+    else if (query->claim_sets == NULL)
+    {
+        cJSON *matched_claim_names = cJSON_CreateArray();
+        StoreAddItemToArray(matched_claim_names, StoreGetObjectItemCaseSensitive(candidate, "shared_attribute_display_name"));
+
+        cJSON *claim;
+        int matched_claim_count = 0;
+        cJSON_ArrayForEach(claim, query->claims)
         {
-            if (!cJSON_HasObjectItem(meta, "credential_authorization_jwt"))
+            if (MatchClaim(candidate_claims, claim))
             {
-                return matched_credentials;
+                ++matched_claim_count;
             }
-            char *cred_auth_jwt = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(meta, "credential_authorization_jwt"));
-            int delimiter = '.';
-            char *payload_start = strchr(cred_auth_jwt, delimiter);
-            payload_start++;
-            char *payload_end = strchr(payload_start, delimiter);
-            *payload_end = '\0';
-            char *decoded_cred_auth_json;
-            int decoded_cred_auth_json_len = B64DecodeURL(payload_start, &decoded_cred_auth_json);
-            cJSON *cred_auth_json = cJSON_Parse(decoded_cred_auth_json);
-            if (!cJSON_HasObjectItem(cred_auth_json, "iss"))
+        }
+        cJSON_AddItemReferenceToObject(matched_credential, "matched_claim_names", matched_claim_names);
+        if (matched_claim_count == cJSON_GetArraySize(query->claims))
+        {
+            cJSON_AddItemReferenceToArray(query->matched_credentials, matched_credential);
+            query->matched++;
+        }
+    }
+    else
+    {
+        cJSON *matched_claim_ids = cJSON_CreateObject();
+
+        cJSON *claim;
+        cJSON_ArrayForEach(claim, query->claims)
+        {
+            char *claim_id = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(claim, "id"));
+            if (MatchClaim(candidate_claims, claim))
             {
-                return matched_credentials;
+                cJSON_AddItemReferenceToObject(matched_claim_ids, claim_id, cJSON_CreateString("PLACEHOLDER"));
             }
-            char *iss_value = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(cred_auth_json, "iss"));
-
-            cJSON *vct_values_obj = cJSON_GetObjectItemCaseSensitive(meta, "vct_values");
-            cJSON *cred_candidates = candidates;
-            candidates = cJSON_CreateArray();
-            cJSON *vct_value;
-            cJSON_ArrayForEach(vct_value, vct_values_obj)
+        }
+        cJSON *claim_set;
+        cJSON_ArrayForEach(claim_set, query->claim_sets)
+        {
+            cJSON *matched_claim_names = cJSON_CreateArray();
+            int matched_claim_count = 0;
+            cJSON *c;
+            cJSON_ArrayForEach(c, claim_set)
             {
-                cJSON *vct_candidates = cJSON_GetObjectItemCaseSensitive(cred_candidates, cJSON_GetStringValue(vct_value));
-                cJSON *curr_candidate;
-                cJSON_ArrayForEach(curr_candidate, vct_candidates)
+                if (cJSON_HasObjectItem(matched_claim_ids, cJSON_GetStringValue(c)))
                 {
-                    cJSON *iss_allowlist = cJSON_GetObjectItemCaseSensitive(curr_candidate, "iss_allowlist");
-                    if (iss_allowlist == NULL)
-                    {
-                        cJSON_AddItemReferenceToArray(candidates, curr_candidate);
-                    }
-                    else if (cJSON_GetObjectItemCaseSensitive(iss_allowlist, iss_value) != NULL)
-                    {
-                        cJSON_AddItemReferenceToArray(candidates, curr_candidate);
-                    }
+                    ++matched_claim_count;
                 }
             }
-            if (cJSON_HasObjectItem(cred_auth_json, "consent_data"))
+            if (matched_claim_count == cJSON_GetArraySize(claim_set))
             {
-                char *consent_data = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(cred_auth_json, "consent_data"));
-                char *decoded_consent_data_json;
-                int decoded_consent_data_json_len = B64DecodeURL(consent_data, &decoded_consent_data_json);
-                cJSON *consent_data_json = cJSON_Parse(decoded_consent_data_json);
-                aggregator_consent = cJSON_GetObjectItemCaseSensitive(consent_data_json, "consent_text");
-                aggregator_policy_url = cJSON_GetObjectItemCaseSensitive(consent_data_json, "policy_link");
-                aggregator_policy_text = cJSON_GetObjectItemCaseSensitive(consent_data_json, "policy_text");
+                StoreAddItemToArray(matched_claim_names, StoreGetObjectItemCaseSensitive(candidate, "shared_attribute_display_name"));
+                cJSON_AddItemReferenceToObject(matched_credential, "matched_claim_names", matched_claim_names);
+                cJSON_AddItemReferenceToArray(query->matched_credentials, matched_credential);
+                query->matched++;
+                break;
             }
         }
-        else
-        {
-            return matched_credentials;
-        }
     }
-    else
+}
+
+cJSON *MatchCredential(cJSON *credential, StoreRef credential_store)
+{
+    cJSON *matched_credentials = cJSON_CreateArray();
+    char *format = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(credential, "format"));
+
+    // check for optional params
+    cJSON *meta = cJSON_GetObjectItemCaseSensitive(credential, "meta");
+    cJSON *claims = cJSON_GetObjectItemCaseSensitive(credential, "claims");
+    cJSON *claim_sets = cJSON_GetObjectItemCaseSensitive(credential, "claim_sets");
+
+    StoreRef candidates = StoreGetObjectItemCaseSensitive(credential_store, format);
+
+    if (candidates == NULL)
     {
         return matched_credentials;
     }
 
-    if (candidates == NULL)
+    // Filter by meta
+    if (meta == NULL || strcmp(format, "dc-authorization+sd-jwt") != 0)
+    {
+        return matched_credentials;
+    }
+    if (!cJSON_HasObjectItem(meta, "credential_authorization_jwt"))
+    {
+        return matched_credentials;
+    }
+    char *cred_auth_jwt = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(meta, "credential_authorization_jwt"));
+    const CredentialAuthorization *authorization = GetCredentialAuthorization(cred_auth_jwt);
+    if (!authorization->has_iss)
     {
         return matched_credentials;
     }
 
-    // Match on the claims
-    if (claims == NULL)
+    CandidateQuery query = {0};
+    query.claims = claims;
+    query.claim_sets = claim_sets;
+    query.matched_credentials = matched_credentials;
+    query.aggregator_consent = authorization->consent;
+    query.aggregator_policy_url = authorization->policy_url;
+    query.aggregator_policy_text = authorization->policy_text;
+
+    // Candidates whose path filter lacks a requested path are skipped before resolving any
+    if (claims != NULL)
     {
-        // Match every candidate
-        cJSON *candidate;
-        cJSON_ArrayForEach(candidate, candidates)
-        {
-            cJSON *matched_credential = cJSON_CreateObject();
-            cJSON_AddItemReferenceToObject(matched_credential, "id", cJSON_GetObjectItemCaseSensitive(candidate, "id"));
-            cJSON_AddItemReferenceToObject(matched_credential, "title", cJSON_GetObjectItemCaseSensitive(candidate, "title"));
-            cJSON_AddItemReferenceToObject(matched_credential, "subtitle", cJSON_GetObjectItemCaseSensitive(candidate, "subtitle"));
-            cJSON_AddItemReferenceToObject(matched_credential, "disclaimer", cJSON_GetObjectItemCaseSensitive(candidate, "disclaimer"));
-            cJSON_AddItemReferenceToObject(matched_credential, "icon", cJSON_GetObjectItemCaseSensitive(candidate, "icon"));
-            cJSON_AddItemReferenceToObject(matched_credential, "aggregator_consent", aggregator_consent);
-            cJSON_AddItemReferenceToObject(matched_credential, "aggregator_policy_text", aggregator_policy_text);
-            cJSON_AddItemReferenceToObject(matched_credential, "aggregator_policy_url", aggregator_policy_url);
-            cJSON *matched_claim_names = cJSON_CreateArray();
-            // printf("candidate %s\n", cJSON_Print(candidate));
-            cJSON_AddItemReferenceToArray(matched_claim_names, cJSON_GetObjectItemCaseSensitive(candidate, "shared_attribute_display_name"));
-            cJSON_AddItemReferenceToObject(matched_credential, "matched_claim_names", matched_claim_names);
-            cJSON_AddItemReferenceToArray(matched_credentials, matched_credential);
-        }
+        PlanClaims(claims, claim_sets, &query.plan);
     }
-    else
+
+    cJSON *vct_values_obj = cJSON_GetObjectItemCaseSensitive(meta, "vct_values");
+    cJSON *vct_value;
+    // Up to MATCHER_ENTRY_LIMIT candidates, in registry order
+    cJSON_ArrayForEach(vct_value, vct_values_obj)
     {
-        if (claim_sets == NULL)
+        StoreRef vct_candidates = StoreGetObjectItemCaseSensitive(candidates, cJSON_GetStringValue(vct_value));
+        StoreRef curr_candidate;
+        StoreArrayForEach(curr_candidate, vct_candidates)
         {
-            cJSON *candidate;
-            cJSON_ArrayForEach(candidate, candidates)
+            if (EntryLimitReached(query.matched))
             {
-                cJSON *matched_credential = cJSON_CreateObject();
-                cJSON_AddItemReferenceToObject(matched_credential, "id", cJSON_GetObjectItemCaseSensitive(candidate, "id"));
-                cJSON_AddItemReferenceToObject(matched_credential, "title", cJSON_GetObjectItemCaseSensitive(candidate, "title"));
-                cJSON_AddItemReferenceToObject(matched_credential, "subtitle", cJSON_GetObjectItemCaseSensitive(candidate, "subtitle"));
-                cJSON_AddItemReferenceToObject(matched_credential, "disclaimer", cJSON_GetObjectItemCaseSensitive(candidate, "disclaimer"));
-                cJSON_AddItemReferenceToObject(matched_credential, "icon", cJSON_GetObjectItemCaseSensitive(candidate, "icon"));
-                cJSON_AddItemReferenceToObject(matched_credential, "aggregator_consent", aggregator_consent);
-                cJSON_AddItemReferenceToObject(matched_credential, "aggregator_policy_text", aggregator_policy_text);
-                cJSON_AddItemReferenceToObject(matched_credential, "aggregator_policy_url", aggregator_policy_url);
-                cJSON *matched_claim_names = cJSON_CreateArray();
-                cJSON_AddItemReferenceToArray(matched_claim_names, cJSON_GetObjectItemCaseSensitive(candidate, "shared_attribute_display_name"));
-
-                cJSON *claim;
-                cJSON *candidate_claims = cJSON_GetObjectItemCaseSensitive(candidate, "paths");
-                int matched_claim_count = 0;
-                cJSON_ArrayForEach(claim, claims)
-                {
-                    cJSON *claim_values = cJSON_GetObjectItemCaseSensitive(claim, "values");
-                    cJSON *paths = cJSON_GetObjectItemCaseSensitive(claim, "path");
-                    cJSON *curr_path;
-                    cJSON *curr_claim = candidate_claims;
-                    int matched = 1;
-                    cJSON_ArrayForEach(curr_path, paths)
-                    {
-                        char *path_value = cJSON_GetStringValue(curr_path);
-                        if (cJSON_HasObjectItem(curr_claim, path_value))
-                        {
-                            curr_claim = cJSON_GetObjectItemCaseSensitive(curr_claim, path_value);
-                        }
-                        else
-                        {
-                            matched = 0;
-                            break;
-                        }
-                    }
-                    if (matched != 0 && curr_claim != NULL)
-                    {
-                        if (claim_values != NULL)
-                        {
-                            cJSON *v;
-                            cJSON_ArrayForEach(v, claim_values)
-                            {
-                                if (cJSON_Compare(v, cJSON_GetObjectItemCaseSensitive(curr_claim, "value"), cJSON_True))
-                                {
-                                    ++matched_claim_count;
-                                    break;
-                                }
-                            }
-                        }
-                        else
-                        {
-                            ++matched_claim_count;
-                        }
-                    }
-                }
-                cJSON_AddItemReferenceToObject(matched_credential, "matched_claim_names", matched_claim_names);
-                if (matched_claim_count == cJSON_GetArraySize(claims))
-                {
-                    cJSON_AddItemReferenceToArray(matched_credentials, matched_credential);
-                }
+                break;
             }
-        }
-        else
-        {
-            cJSON *candidate;
-            cJSON_ArrayForEach(candidate, candidates)
+            if (IssAllowed(curr_candidate, authorization))
             {
-                cJSON *matched_credential = cJSON_CreateObject();
-                cJSON_AddItemReferenceToObject(matched_credential, "id", cJSON_GetObjectItemCaseSensitive(candidate, "id"));
-                cJSON_AddItemReferenceToObject(matched_credential, "title", cJSON_GetObjectItemCaseSensitive(candidate, "title"));
-                cJSON_AddItemReferenceToObject(matched_credential, "subtitle", cJSON_GetObjectItemCaseSensitive(candidate, "subtitle"));
-                cJSON_AddItemReferenceToObject(matched_credential, "disclaimer", cJSON_GetObjectItemCaseSensitive(candidate, "disclaimer"));
-                cJSON_AddItemReferenceToObject(matched_credential, "icon", cJSON_GetObjectItemCaseSensitive(candidate, "icon"));
-                cJSON_AddItemReferenceToObject(matched_credential, "aggregator_consent", aggregator_consent);
-                cJSON_AddItemReferenceToObject(matched_credential, "aggregator_policy_text", aggregator_policy_text);
-                cJSON_AddItemReferenceToObject(matched_credential, "aggregator_policy_url", aggregator_policy_url);
-                cJSON *matched_claim_ids = cJSON_CreateObject();
-
-                cJSON *claim;
-                cJSON *candidate_claims = cJSON_GetObjectItemCaseSensitive(candidate, "paths");
-                cJSON_ArrayForEach(claim, claims)
-                {
-                    cJSON *claim_values = cJSON_GetObjectItemCaseSensitive(claim, "values");
-                    char *claim_id = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(claim, "id"));
-                    cJSON *paths = cJSON_GetObjectItemCaseSensitive(claim, "path");
-                    cJSON *curr_path;
-                    cJSON *curr_claim = candidate_claims;
-                    int matched = 1;
-                    cJSON_ArrayForEach(curr_path, paths)
-                    {
-                        char *path_value = cJSON_GetStringValue(curr_path);
-                        if (cJSON_HasObjectItem(curr_claim, path_value))
-                        {
-                            curr_claim = cJSON_GetObjectItemCaseSensitive(curr_claim, path_value);
-                        }
-                        else
-                        {
-                            matched = 0;
-                            break;
-                        }
-                    }
-                    if (matched != 0 && curr_claim != NULL)
-                    {
-                        if (claim_values != NULL)
-                        {
-                            cJSON *v;
-                            cJSON_ArrayForEach(v, claim_values)
-                            {
-                                if (cJSON_Compare(v, cJSON_GetObjectItemCaseSensitive(curr_claim, "value"), cJSON_True))
-                                {
-                                    cJSON_AddItemReferenceToObject(matched_claim_ids, claim_id, cJSON_CreateString("PLACEHOLDER"));
-                                    break;
-                                }
-                            }
-                        }
-                        else
-                        {
-                            cJSON_AddItemReferenceToObject(matched_claim_ids, claim_id, cJSON_CreateString("PLACEHOLDER"));
-                        }
-                    }
-                }
-                cJSON *claim_set;
-                cJSON_ArrayForEach(claim_set, claim_sets)
-                {
-                    cJSON *matched_claim_names = cJSON_CreateArray();
-                    int matched_claim_count = 0;
-                    cJSON *c;
-                    cJSON_ArrayForEach(c, claim_set)
-                    {
-                        if (cJSON_HasObjectItem(matched_claim_ids, cJSON_GetStringValue(c)))
-                        {
-                            ++matched_claim_count;
-                        }
-                    }
-                    if (matched_claim_count == cJSON_GetArraySize(claim_set))
-                    {
-                        cJSON_AddItemReferenceToArray(matched_claim_names, cJSON_GetObjectItemCaseSensitive(candidate, "shared_attribute_display_name"));
-                        cJSON_AddItemReferenceToObject(matched_credential, "matched_claim_names", matched_claim_names);
-                        cJSON_AddItemReferenceToArray(matched_credentials, matched_credential);
-                        break;
-                    }
-                }
+                MatchCandidate(&query, curr_candidate);
             }
         }
     }
 
+    if (claims != NULL)
+    {
+        FreeClaimPlan(&query.plan);
+    }
     return matched_credentials;
 }
 
-cJSON *dcql_query(cJSON *query, cJSON *credential_store)
+cJSON *dcql_query(cJSON *query, StoreRef credential_store)
 {
     cJSON *matched_credentials = cJSON_CreateObject();
     cJSON *candidate_matched_credentials = cJSON_CreateObject();
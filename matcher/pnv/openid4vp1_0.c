@@ -7,18 +7,26 @@
 
 #include "../base64.h"
 #include "../dcql.h"
+#include "../debug.h"
+#include "../entry_dedup.h"
+#include "../entry_id.h"
 #include "../icon.h"
+#include "../query_cache.h"
+#include "../registry.h"
+#include "../request_scan.h"
+#include "../transaction_data.h"
 
 #define PROTOCOL_OPENID4VP_1_0_UNSIGNED "openid4vp-v1-unsigned"
 #define PROTOCOL_OPENID4VP_1_0_SIGNED "openid4vp-v1-signed"
 // TODO: #define PROTOCOL_OPENID4VP_1_0_MULTISIGNED "openid4vp-v1-multisigned"
 
-cJSON* GetDCRequestJson() {
+char* GetDCRequest(size_t* request_len) {
     uint32_t request_size;
     GetRequestSize(&request_size);
     char* request_json = malloc(request_size);
     GetRequestBuffer(request_json);
-    return cJSON_Parse(request_json);
+    *request_len = strnlen(request_json, request_size);
+    return request_json;
 }
 
 cJSON* GetCredsJson() {
@@ -30,57 +38,25 @@ cJSON* GetCredsJson() {
 }
 
 int main() {
-    uint32_t credentials_size;
-    GetCredentialsSize(&credentials_size);
-
-    char* creds_blob = malloc(credentials_size);
-    ReadCredentialsBuffer(creds_blob, 0, credentials_size);
+    size_t request_len;
+    char* dc_request = GetDCRequest(&request_len);
+    DEBUG_LOG("Request JSON %.*s\n", (int)request_len, dc_request);
 
-    int json_offset = *((int*)creds_blob);
-    printf("Creds JSON offset %d\n", json_offset);
-
-    cJSON* creds = cJSON_Parse(creds_blob + json_offset);
-    cJSON* credential_store = cJSON_GetObjectItem(creds, "credentials");
-    printf("Creds JSON %s\n", cJSON_Print(credential_store));
-
-    cJSON* dc_request = GetDCRequestJson();
-    printf("Request JSON %s\n", cJSON_Print(dc_request));
-
-    // Parse each top level request looking for OpenID4VP requests
-    cJSON_bool is_modern_request = cJSON_HasObjectItem(dc_request, "requests");
-    cJSON* requests;
-    if (is_modern_request) {
-        requests = cJSON_GetObjectItem(dc_request, "requests");
-    } else {
-        requests = cJSON_GetObjectItem(dc_request, "providers");
-    }
-    int requests_size = cJSON_GetArraySize(requests);
+    // Scan the top level requests looking for OpenID4VP requests, only their data is parsed
+    ScannedRequest* requests;
+    int requests_size = ScanRequests(dc_request, request_len, &requests);
 
     int matched = 0;
+    int entries = 0;
     int should_offer_issuance = 0;
     char* merchant_name = NULL;
     char* transaction_amount = NULL;
-    for(int i=0; i<requests_size; i++) {
-        cJSON* request = cJSON_GetArrayItem(requests, i);
-        //printf("Request %s\n", cJSON_Print(request));
-
-        char* protocol = cJSON_GetStringValue(cJSON_GetObjectItem(request, "protocol"));
-        if (strcmp(protocol, PROTOCOL_OPENID4VP_1_0_UNSIGNED) == 0 || strcmp(protocol, PROTOCOL_OPENID4VP_1_0_SIGNED) == 0) {
-            // We have an OpenID4VP request
-            cJSON* data_json;
-            if (is_modern_request) {
-                data_json = cJSON_GetObjectItem(request, "data");
-                if (cJSON_IsString(data_json)) { // Legacy spec
-                    char* data_json_string = cJSON_GetStringValue(data_json);
-                    data_json = cJSON_Parse(data_json_string);
-                }
-            } else { // Legacy spec
-                cJSON* data = cJSON_GetObjectItem(request, "request");
-                char* data_json_string = cJSON_GetStringValue(data);
-                data_json = cJSON_Parse(data_json_string);
-            }
+    for(int i=0; i<requests_size && !EntryLimitReached(entries); i++) {
+        if (SpanIsString(requests[i].protocol, PROTOCOL_OPENID4VP_1_0_UNSIGNED) || SpanIsString(requests[i].protocol, PROTOCOL_OPENID4VP_1_0_SIGNED)) {
+            // We have an OpenID4VP request, data given as a string (legacy spec) is unwrapped
+            cJSON* data_json = ParseRequestData(requests[i].data);
 
-            if (strcmp(protocol, PROTOCOL_OPENID4VP_1_0_SIGNED) == 0) {
+            if (SpanIsString(requests[i].protocol, PROTOCOL_OPENID4VP_1_0_SIGNED)) {
                 cJSON* signed_request = cJSON_GetObjectItem(data_json, "request");
                 char* signed_request_string = cJSON_GetStringValue(signed_request);
                 int delimiter = '.';
@@ -89,7 +65,7 @@ int main() {
                 char* payload_end = strchr(payload_start, delimiter);
                 *payload_end = '\0';
                 char* decoded_request_json;
-                int decoded_request_json_len = B64DecodeURL(payload_start, &decoded_request_json);
+                B64DecodeURL(payload_start, &decoded_request_json);
                 data_json = cJSON_Parse(decoded_request_json);
             }
             cJSON* query = cJSON_GetObjectItem(data_json, "dcql_query");
@@ -97,27 +73,21 @@ int main() {
                 should_offer_issuance = 1;
             }
 
-            // For now we only support one transaction data item
-
-            cJSON* transaction_data_list = cJSON_GetObjectItem(data_json, "transaction_data");
-
-            cJSON* transaction_data = NULL;
-            cJSON* transaction_credential_ids = NULL;
-            if (transaction_data_list != NULL) {
-                if(cJSON_GetArraySize(transaction_data_list) == 1) {
-                    cJSON* transaction_data_encoded = cJSON_GetArrayItem(transaction_data_list, 0);
-                    char* transaction_data_encoded_str = cJSON_GetStringValue(transaction_data_encoded);
-                    char* transaction_data_json;
-                    int transaction_data_json_len = B64DecodeURL(transaction_data_encoded_str, &transaction_data_json);
-                    transaction_data = cJSON_Parse(transaction_data_json);
-                    transaction_credential_ids = cJSON_GetObjectItem(transaction_data, "credential_ids");
-                    merchant_name = cJSON_GetStringValue(cJSON_GetObjectItem(transaction_data, "merchant_name"));
-                    transaction_amount = cJSON_GetStringValue(cJSON_GetObjectItem(transaction_data, "amount"));
-                }
-                
+            TransactionData transaction_data;
+            ParseTransactionData(cJSON_GetObjectItem(data_json, "transaction_data"), &transaction_data);
+            if (transaction_data.items_count > 0) {
+                merchant_name = transaction_data.merchant_name;
+                transaction_amount = transaction_data.amount;
             }
 
-            cJSON* matched_docs = dcql_query(query, credential_store);
+            // The summary at the start of the registry rules out most queries for credentials
+            // this wallet doesn't hold, without reading the rest of it.
+            if (!RegistryMayMatch(query)) {
+                continue;
+            }
+            Registry* registry = GetRegistryForQuery(query);
+            StoreRef credential_store = GetRegistryCredentials(registry);
+            cJSON* matched_docs = CachedDcqlQuery(query, credential_store);
             //printf("matched_creds %d\n", cJSON_GetArraySize(matched_creds));
 //            printf("matched_creds %s\n", cJSON_Print(cJSON_GetArrayItem(matched_creds,0)));
 
@@ -126,66 +96,65 @@ int main() {
             cJSON_ArrayForEach(matched_doc, matched_docs) {
                 cJSON* matched_cred = cJSON_GetObjectItem(matched_doc, "matched");
                 cJSON* doc_id = cJSON_GetObjectItem(matched_doc, "id");
+                const TransactionItem* transaction_item = FindTransactionItem(&transaction_data, cJSON_GetStringValue(doc_id));
                 cJSON* c;
                 cJSON_ArrayForEach(c, matched_cred) {
+                    if (EntryLimitReached(entries)) {
+                        break;
+                    }
     //                printf("cred %s\n", cJSON_Print(c));
-                    cJSON* id_obj = cJSON_CreateObject();
-                    cJSON* matched_id = cJSON_GetObjectItem(c, "id");
-
-                    cJSON_AddItemReferenceToObject(id_obj, "entry_id", matched_id);
-                    cJSON_AddItemReferenceToObject(id_obj, "dcql_cred_id", doc_id);
-                    cJSON_AddItemReferenceToObject(id_obj, "req_idx", cJSON_CreateNumber(i));
-                    char* id = cJSON_PrintUnformatted(id_obj);
-
-                    if (transaction_credential_ids != NULL) {
-                        printf("transaction cred ids %s\n", cJSON_Print(transaction_credential_ids));
-                        cJSON* transaction_credential_id;
-                        cJSON_ArrayForEach(transaction_credential_id, transaction_credential_ids) {
-                            printf("comparing cred id %s with transaction cred id %s.\n", cJSON_Print(doc_id), cJSON_Print(transaction_credential_id));
-                            if (cJSON_Compare(transaction_credential_id, doc_id, cJSON_True)) {
-
+                    char id_buffer[ENTRY_ID_BUFFER_SIZE];
+                    char* cred_id = cJSON_GetStringValue(cJSON_GetObjectItem(c, "id"));
+                    char* id = EncodeEntryId(id_buffer, cred_id, cJSON_GetStringValue(doc_id), i);
+
+                    if (transaction_data.count > 0) {
+                        // Credentials that no transaction data item applies to are not offered
+                        if (transaction_item != NULL) {
+                            EntryKeyStart(cred_id);
+                            EntryKeyAddValue(transaction_item->merchant_name);
+                            EntryKeyAddValue(transaction_item->amount);
+                            if (EntryKeyIsNew()) {
                                 char *title = cJSON_GetStringValue(cJSON_GetObjectItem(c, "title"));
                                 char *subtitle = cJSON_GetStringValue(cJSON_GetObjectItem(c, "subtitle"));
-                                cJSON* icon = cJSON_GetObjectItem(c, "icon");
-                                printf("transaction cred ids %s\n", cJSON_Print(transaction_credential_ids));
-
-                                double icon_start = (cJSON_GetNumberValue(cJSON_GetObjectItem(icon, "start")));
-                                int icon_start_int = icon_start;
-                                printf("icon_start int %d, double %f\n", icon_start_int, icon_start);
-                                int icon_len = (int)(cJSON_GetNumberValue(cJSON_GetObjectItem(icon, "length")));
+                                int icon_len;
+                                char* icon = GetRegistryIcon(registry, c, &icon_len);
 
-                                AddPaymentEntry(id, merchant_name, title, subtitle, creds_blob + icon_start_int, icon_len, transaction_amount, NULL, 0, NULL, 0);
+                                AddPaymentEntry(id, transaction_item->merchant_name, title, subtitle, icon, icon_len, transaction_item->amount, NULL, 0, NULL, 0);
                                 matched = 1;
-                                break;
+                                entries++;
                             }
                         }
                     } else {
-                        char *title = cJSON_GetStringValue(cJSON_GetObjectItem(c, "title"));
-                        char *subtitle = cJSON_GetStringValue(cJSON_GetObjectItem(c, "subtitle"));
-                        char *disclaimer = cJSON_GetStringValue(cJSON_GetObjectItem(c, "disclaimer"));
                         char *aggregator_consent = cJSON_GetStringValue(cJSON_GetObjectItem(c, "aggregator_consent"));
                         char *aggregator_policy_url = cJSON_GetStringValue(cJSON_GetObjectItem(c, "aggregator_policy_url"));
                         char *aggregator_policy_text = cJSON_GetStringValue(cJSON_GetObjectItem(c, "aggregator_policy_text"));
-                        cJSON* icon = cJSON_GetObjectItem(c, "icon");
-                        int icon_start_int = 0;
-                        int icon_len = 0;
-                        if (icon != NULL) {
-                            cJSON* start = cJSON_GetObjectItem(icon, "start");
-                            cJSON* length = cJSON_GetObjectItem(icon, "length");
-                            if (start != NULL && length != NULL) {
-                                double icon_start = (cJSON_GetNumberValue(start));
-                                icon_start_int = icon_start;
-                                icon_len = (int)(cJSON_GetNumberValue(length));
-                            }
-                        }
-                        matched = 1;
-                        AddStringIdEntry(id, creds_blob + icon_start_int, icon_len, title, subtitle, disclaimer, NULL);
-                        SetAdditionalDisclaimerAndUrlForVerificationEntry(id, aggregator_consent, aggregator_policy_text, aggregator_policy_url);
                         cJSON *matched_claim_names = cJSON_GetObjectItem(c, "matched_claim_names");
                         cJSON *claim;
+                        // The consent comes with the credential query, matches for other aggregators stay apart
+                        EntryKeyStart(cred_id);
+                        EntryKeyAddValue(aggregator_consent);
+                        EntryKeyAddValue(aggregator_policy_url);
+                        EntryKeyAddValue(aggregator_policy_text);
                         cJSON_ArrayForEach(claim, matched_claim_names) {
-                            AddFieldForStringIdEntry(id, cJSON_GetStringValue(claim), NULL);
+                            EntryKeyAddField(cJSON_GetStringValue(claim));
                         }
+                        if (EntryKeyIsNew()) {
+                            char *title = cJSON_GetStringValue(cJSON_GetObjectItem(c, "title"));
+                            char *subtitle = cJSON_GetStringValue(cJSON_GetObjectItem(c, "subtitle"));
+                            char *disclaimer = cJSON_GetStringValue(cJSON_GetObjectItem(c, "disclaimer"));
+                            int icon_len;
+                            char* icon = GetRegistryIcon(registry, c, &icon_len);
+                            matched = 1;
+                            AddStringIdEntry(id, icon, icon_len, title, subtitle, disclaimer, NULL);
+                            SetAdditionalDisclaimerAndUrlForVerificationEntry(id, aggregator_consent, aggregator_policy_text, aggregator_policy_url);
+                            cJSON_ArrayForEach(claim, matched_claim_names) {
+                                AddFieldForStringIdEntry(id, cJSON_GetStringValue(claim), NULL);
+                            }
+                            entries++;
+                        }
+                    }
+                    if (id != id_buffer) {
+                        free(id);
                     }
                 }
 
@@ -0,0 +1,68 @@
+#include <stdlib.h>
+
+#include "dcql.h"
+#include "debug.h"
+#include "hash.h"
+#include "query_cache.h"
+
+typedef struct CachedQuery {
+    uint32_t hash;
+    cJSON* query;
+    cJSON* result;
+} CachedQuery;
+
+static CachedQuery* cache;
+static int cache_size;
+static int cache_capacity;
+
+static uint32_t Mix(uint32_t hash, uint32_t value) {
+    return (hash ^ value) * HASH_FNV_PRIME;
+}
+
+// Hash of the query normalized the way cJSON_Compare sees it: object members are combined
+// independently of their order, array elements in order.
+static uint32_t HashJson(const cJSON* item) {
+    if (item == NULL) {
+        return HASH_FNV_OFFSET;
+    }
+    uint32_t hash = Mix(HASH_FNV_OFFSET, item->type & 0xff);
+    if (cJSON_IsString(item)) {
+        return Mix(hash, HashString(item->valuestring));
+    }
+    if (cJSON_IsNumber(item)) {
+        return Mix(hash, HashBytes(&item->valuedouble, sizeof(item->valuedouble)));
+    }
+    cJSON* child;
+    if (cJSON_IsArray(item)) {
+        cJSON_ArrayForEach(child, item) {
+            hash = Mix(hash, HashJson(child));
+        }
+    } else if (cJSON_IsObject(item)) {
+        uint32_t members = 0;
+        cJSON_ArrayForEach(child, item) {
+            members += Mix(HashString(child->string), HashJson(child));
+        }
+        hash = Mix(hash, members);
+    }
+    return hash;
+}
+
+cJSON* CachedDcqlQuery(cJSON* query, StoreRef credential_store) {
+    uint32_t hash = HashJson(query);
+    for (int i=0; i<cache_size; i++) {
+        if (cache[i].hash == hash && cJSON_Compare(cache[i].query, query, cJSON_True)) {
+            DEBUG_LOG("Reusing the result of query %d\n", i);
+            return cache[i].result;
+        }
+    }
+    cJSON* result = dcql_query(query, credential_store);
+    if (cache_size == cache_capacity) {
+        cache_capacity = cache_capacity == 0 ? 4 : cache_capacity * 2;
+        cache = realloc(cache, sizeof(CachedQuery) * cache_capacity);
+    }
+    cache[cache_size].hash = hash;
+    cache[cache_size].query = query;
+    cache[cache_size].result = result;
+    cache_size++;
+    return result;
+}
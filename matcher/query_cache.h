@@ -0,0 +1,12 @@
+#ifndef QUERY_CACHE_H
+#define QUERY_CACHE_H
+
+#include "cJSON/cJSON.h"
+#include "store.h"
+
+// Returns dcql_query(query, credential_store), reusing the result of an earlier call of this run
+// with an equal query. Verifiers often send the same DCQL query under several protocols, e.g.
+// signed and unsigned OpenID4VP side by side. The store has to be the same for every call.
+cJSON* CachedDcqlQuery(cJSON* query, StoreRef credential_store);
+
+#endif
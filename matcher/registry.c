@@ -0,0 +1,385 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "credentialmanager.h"
+#include "debug.h"
+#include "hash.h"
+#include "registry.h"
+
+static Registry registry;
+
+typedef struct RegistrySummary {
+    int loaded;
+    int present;
+    uint32_t formats;
+    uint32_t* type_hashes;
+    uint32_t type_count;
+} RegistrySummary;
+
+static RegistrySummary summary;
+
+// Entries written with a {start, length} icon share the ranges of the icons table, so a streamed
+// registry reads each distinct range once too. There are as many as distinct icons, a linear
+// search is enough.
+typedef struct RegistryRangeIcons {
+    RegistryIcon* ranges;
+    char** data;
+    int count;
+    int capacity;
+} RegistryRangeIcons;
+
+static StoreRef RegistryJson(const Registry* registry) {
+#if defined(REGISTRY_TAPE)
+    return registry->tape;
+#else
+    return registry->json;
+#endif
+}
+
+// Reads the {start, length} of an icon, NAN for members that are not numbers.
+static int ReadIconRange(double start, double length, uint32_t blob_size, RegistryIcon* range) {
+    if (isnan(start) || isnan(length)) {
+        return 0;
+    }
+    if (start < 0 || length < 0 || start + length > blob_size) {
+        return 0;
+    }
+    range->start = start;
+    range->length = length;
+    return 1;
+}
+
+// Resolve the icon table once so that lookups by id don't walk the json list.
+static void ResolveIcons() {
+    StoreRef icons = StoreGetObjectItem(RegistryJson(&registry), "icons");
+    registry.icons_count = StoreGetArraySize(icons);
+    registry.icons = malloc(sizeof(RegistryIcon) * (registry.icons_count > 0 ? registry.icons_count : 1));
+    int i = 0;
+    StoreRef icon;
+    StoreArrayForEach(icon, icons) {
+        double start = StoreGetNumberValue(StoreGetObjectItem(icon, "start"));
+        double length = StoreGetNumberValue(StoreGetObjectItem(icon, "length"));
+        if (!ReadIconRange(start, length, registry.size, &registry.icons[i])) {
+            registry.icons[i].start = 0;
+            registry.icons[i].length = 0;
+        }
+        i++;
+    }
+}
+
+static void ParseRegistry() {
+    int json_offset = *((int*)registry.blob);
+    DEBUG_LOG("Creds JSON offset %d\n", json_offset);
+#if defined(REGISTRY_TAPE)
+    registry.tape = TapeParse(registry.blob + json_offset);
+#else
+    registry.json = cJSON_Parse(registry.blob + json_offset);
+#endif
+    ResolveIcons();
+}
+
+static uint32_t ReadU32(const unsigned char* bytes) {
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+// Reads len bytes at offset, from blob if the registry is already in memory.
+static void ReadRegistryRange(const char* blob, void* buffer, uint32_t offset, uint32_t len) {
+    if (blob != NULL) {
+        memcpy(buffer, blob + offset, len);
+    } else {
+        ReadCredentialsBuffer(buffer, offset, len);
+    }
+}
+
+// Reads the content hash of the summary of a size bytes registry, from blob if it is in memory.
+// Returns 0 if the registry has no summary or a summary written before the hash.
+static int ReadContentHash(const char* blob, uint32_t size, uint32_t* hash) {
+    unsigned char header[20];
+    if (size < sizeof(header)) {
+        return 0;
+    }
+    ReadRegistryRange(blob, header, 0, sizeof(header));
+    if (memcmp(header + 4, REGISTRY_SUMMARY_MAGIC, 4) != 0) {
+        return 0;
+    }
+    uint32_t summary_len = ReadU32(header + 8);
+    uint32_t count = ReadU32(header + 16);
+    if (summary_len < 20 || summary_len > size - 4 || count > (summary_len - 20) / 4) {
+        return 0;
+    }
+    unsigned char bytes[4];
+    ReadRegistryRange(blob, bytes, 20 + count * 4, sizeof(bytes));
+    *hash = ReadU32(bytes);
+    return 1;
+}
+
+// A pre-initialized snapshot is only valid for the registry it was taken from, which the content
+// hash of its summary identifies. The app only registers a snapshot with a registry of the same
+// hash, the first use checks it again and drops the snapshot if they differ.
+static int snapshot_hashed;
+static uint32_t snapshot_hash;
+
+static void DropStaleSnapshot() {
+    static int checked = 0;
+    if (checked) {
+        return;
+    }
+    checked = 1;
+    if (RegistryJson(&registry) == NULL) {
+        return;
+    }
+    uint32_t size;
+    GetCredentialsSize(&size);
+    uint32_t hash;
+    if (snapshot_hashed && size == registry.size && ReadContentHash(NULL, size, &hash) && hash == snapshot_hash) {
+        return;
+    }
+    DEBUG_LOG("Pre-initialized registry is stale\n");
+    registry.blob = NULL;
+    registry.size = 0;
+#if defined(REGISTRY_TAPE)
+    registry.tape = NULL;
+#else
+    registry.json = NULL;
+#endif
+}
+
+Registry* GetRegistry() {
+    DropStaleSnapshot();
+    uint32_t credentials_size;
+    GetCredentialsSize(&credentials_size);
+    if (RegistryJson(&registry) != NULL && registry.size == credentials_size) {
+        return &registry;
+    }
+    registry.size = credentials_size;
+    registry.blob = malloc(credentials_size);
+    ReadCredentialsBuffer(registry.blob, 0, credentials_size);
+    ParseRegistry();
+    return &registry;
+}
+
+static void LoadSummary() {
+    summary.loaded = 1;
+    DropStaleSnapshot();
+    uint32_t size;
+    GetCredentialsSize(&size);
+    // Same check as in GetRegistry()
+    const char* blob = RegistryJson(&registry) != NULL && registry.size == size ? registry.blob : NULL;
+    unsigned char header[20];
+    if (size < sizeof(header)) {
+        return;
+    }
+    ReadRegistryRange(blob, header, 0, sizeof(header));
+    if (memcmp(header + 4, REGISTRY_SUMMARY_MAGIC, 4) != 0) {
+        return;
+    }
+    uint32_t summary_len = ReadU32(header + 8);
+    uint32_t count = ReadU32(header + 16);
+    if (summary_len < 16 || summary_len > size - 4 || count > (summary_len - 16) / 4) {
+        return;
+    }
+    unsigned char* hashes = malloc(count * 4 + 1);
+    ReadRegistryRange(blob, hashes, 20, count * 4);
+    summary.type_hashes = malloc(sizeof(uint32_t) * (count > 0 ? count : 1));
+    for (uint32_t i = 0; i < count; i++) {
+        summary.type_hashes[i] = ReadU32(hashes + i * 4);
+    }
+    free(hashes);
+    summary.type_count = count;
+    summary.formats = ReadU32(header + 12);
+    summary.present = 1;
+}
+
+static uint32_t FormatBit(const char* format) {
+    if (strcmp(format, "mso_mdoc") == 0) {
+        return REGISTRY_FORMAT_MSO_MDOC;
+    } else if (strcmp(format, "dc+sd-jwt") == 0) {
+        return REGISTRY_FORMAT_SD_JWT;
+    } else if (strcmp(format, "dc-authorization+sd-jwt") == 0) {
+        return REGISTRY_FORMAT_AUTHORIZATION_SD_JWT;
+    }
+    return REGISTRY_FORMAT_OTHER;
+}
+
+static int HasType(const char* type) {
+    uint32_t hash = HashString(type);
+    uint32_t low = 0;
+    uint32_t high = summary.type_count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (summary.type_hashes[mid] < hash) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low < summary.type_count && summary.type_hashes[low] == hash;
+}
+
+// Mirrors the candidate selection of MatchCredential, erring on the side of a match.
+static int CredentialMayMatch(const cJSON* credential) {
+    char* format = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(credential, "format"));
+    if (format == NULL || (summary.formats & FormatBit(format)) == 0) {
+        return 0;
+    }
+    cJSON* meta = cJSON_GetObjectItemCaseSensitive(credential, "meta");
+    if (strcmp(format, "mso_mdoc") == 0) {
+        cJSON* doctype_value = cJSON_GetObjectItemCaseSensitive(meta, "doctype_value");
+        return !cJSON_IsString(doctype_value) || HasType(doctype_value->valuestring);
+    }
+    cJSON* vct_values = cJSON_GetObjectItemCaseSensitive(meta, "vct_values");
+    if (!cJSON_IsArray(vct_values)) {
+        return 1;
+    }
+    cJSON* vct_value;
+    cJSON_ArrayForEach(vct_value, vct_values) {
+        if (cJSON_IsString(vct_value) && HasType(vct_value->valuestring)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int RegistryMayMatch(const cJSON* query) {
+    if (!summary.loaded) {
+        LoadSummary();
+    }
+    if (!summary.present) {
+        return 1;
+    }
+    cJSON* credential;
+    cJSON_ArrayForEach(credential, cJSON_GetObjectItemCaseSensitive(query, "credentials")) {
+        if (CredentialMayMatch(credential)) {
+            return 1;
+        }
+    }
+    DEBUG_LOG("Ruled out by the registry summary\n");
+    return 0;
+}
+
+#if defined(REGISTRY_STREAMING)
+#include "registry_stream.h"
+#endif
+
+Registry* GetRegistryForQuery(const cJSON* query) {
+#if defined(REGISTRY_STREAMING)
+    static const cJSON* streamed_query = NULL;
+    DropStaleSnapshot();
+    uint32_t credentials_size;
+    GetCredentialsSize(&credentials_size);
+    if (registry.json != NULL && registry.size == credentials_size) {
+        // A pre-initialized snapshot, or streamed for an equal query
+        if (registry.blob != NULL || cJSON_Compare(streamed_query, query, cJSON_True)) {
+            return &registry;
+        }
+    }
+    // The json of an earlier query is not freed, its dcql_query results point into it.
+    registry.blob = NULL;
+    registry.size = credentials_size;
+    registry.json = NULL;
+    registry.icons_count = 0;
+    unsigned char offset[4];
+    if (credentials_size >= sizeof(offset) && ReadCredentialsBuffer(offset, 0, sizeof(offset)) == sizeof(offset)) {
+        uint32_t json_offset = offset[0] | (offset[1] << 8) | (offset[2] << 16) | ((uint32_t)offset[3] << 24);
+        DEBUG_LOG("Streaming creds JSON from offset %u\n", json_offset);
+        registry.json = StreamRegistry(query, json_offset, credentials_size);
+    }
+    ResolveIcons();
+    registry.icon_data = calloc(registry.icons_count > 0 ? registry.icons_count : 1, sizeof(char*));
+    registry.range_icons = calloc(1, sizeof(RegistryRangeIcons));
+    streamed_query = query;
+    return &registry;
+#else
+    (void)query;
+    return GetRegistry();
+#endif
+}
+
+StoreRef GetRegistryCredentials(const Registry* registry) {
+    return StoreGetObjectItem(RegistryJson(registry), "credentials");
+}
+
+static char* ReadIcon(RegistryIcon range) {
+    char* icon = malloc(range.length);
+    ReadCredentialsBuffer(icon, range.start, range.length);
+    return icon;
+}
+
+static char* ReadRangeIcon(RegistryRangeIcons* icons, RegistryIcon range) {
+    for (int i = 0; i < icons->count; i++) {
+        if (icons->ranges[i].start == range.start && icons->ranges[i].length == range.length) {
+            return icons->data[i];
+        }
+    }
+    if (icons->count == icons->capacity) {
+        icons->capacity = icons->capacity > 0 ? icons->capacity * 2 : 8;
+        icons->ranges = realloc(icons->ranges, sizeof(RegistryIcon) * icons->capacity);
+        icons->data = realloc(icons->data, sizeof(char*) * icons->capacity);
+    }
+    icons->ranges[icons->count] = range;
+    icons->data[icons->count] = ReadIcon(range);
+    return icons->data[icons->count++];
+}
+
+char* GetRegistryIcon(const Registry* registry, const cJSON* entry, int* icon_len) {
+    cJSON* icon = cJSON_GetObjectItem(entry, "icon");
+    RegistryIcon range = {0, 0};
+    int id = -1;
+    if (cJSON_IsNumber(icon)) {
+        if (icon->valueint >= 0 && icon->valueint < registry->icons_count) {
+            id = icon->valueint;
+            range = registry->icons[id];
+        }
+    } else if (cJSON_IsObject(icon)) {
+        double start = cJSON_GetNumberValue(cJSON_GetObjectItem(icon, "start"));
+        double length = cJSON_GetNumberValue(cJSON_GetObjectItem(icon, "length"));
+        ReadIconRange(start, length, registry->size, &range);
+    }
+    if (range.length == 0) {
+        *icon_len = 0;
+        return NULL;
+    }
+    *icon_len = range.length;
+    if (registry->blob != NULL) {
+        return registry->blob + range.start;
+    }
+    if (id < 0) {
+        return ReadRangeIcon(registry->range_icons, range);
+    }
+    if (registry->icon_data[id] == NULL) {
+        registry->icon_data[id] = ReadIcon(range);
+    }
+    return registry->icon_data[id];
+}
+
+#if defined(MATCHER_PREINIT)
+#ifndef MATCHER_PREINIT_REGISTRY
+#define MATCHER_PREINIT_REGISTRY "registry.bin"
+#endif
+
+// Pre-initialization entry point, run once by Wizer on the host with the registry the snapshot
+// is taken for:
+//   wizer matcher.wasm --allow-wasi --dir . -o matcher.preinit.wasm
+// The credman imports are not available at that point, so the registry is read through WASI.
+// The parsed registry stays in the snapshotted heap and GetRegistry() returns it when the host
+// holds the same registry.
+#if defined(__wasm__)
+__attribute__((export_name("wizer.initialize")))
+#endif
+void MatcherInitialize() {
+    FILE* f = fopen(MATCHER_PREINIT_REGISTRY, "rb");
+    if (f == NULL) {
+        return;
+    }
+    fseek(f, 0, SEEK_END);
+    registry.size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    registry.blob = malloc(registry.size);
+    fread(registry.blob, 1, registry.size, f);
+    fclose(f);
+    snapshot_hashed = ReadContentHash(registry.blob, registry.size, &snapshot_hash);
+    ParseRegistry();
+}
+#endif
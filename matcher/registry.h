@@ -0,0 +1,78 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <stdint.h>
+
+#include "cJSON/cJSON.h"
+#include "store.h"
+
+// The registry blob written by CredentialRepository.createRegistryDatabase
+// (and PnvTokenRegistry.buildRegistryDatabase):
+//
+// |---------------------------------------|
+// |--- (Int) offset of credential json ---|
+// |-------------- Summary ----------------|
+// |--------- (Byte Array) Icon 1 ---------|
+// |------------- More Icons... -----------|
+// |----------- Credential Json -----------|
+// |---------------------------------------|
+//
+// Each distinct icon is stored once. The json has a top level "icons" table of {start, length}
+// blob ranges and entries reference an icon by its index in that table. Registries written before
+// the table existed carry the {start, length} object in the entry itself.
+//
+// The summary lets a matcher rule out a request without reading the rest of the blob. All its
+// fields are little endian u32s:
+//   "CMRS" magic, summary length in bytes, REGISTRY_FORMAT_* bits of the formats holding at least
+//   one credential, count, count FNV-1a hashes (see hash.h) of the mdoc doctypes and sd-jwt vcts
+//   in ascending order, FNV-1a hash of the rest of the blob.
+// The content hash identifies the registry a pre-initialized snapshot was taken from, summaries
+// written before it end after the type hashes. Registries written before the summary go straight
+// to the icons.
+#define REGISTRY_SUMMARY_MAGIC "CMRS"
+#define REGISTRY_FORMAT_MSO_MDOC 0x1
+#define REGISTRY_FORMAT_SD_JWT 0x2 // dc+sd-jwt
+#define REGISTRY_FORMAT_AUTHORIZATION_SD_JWT 0x4 // dc-authorization+sd-jwt
+#define REGISTRY_FORMAT_OTHER 0x80000000
+
+typedef struct RegistryIcon {
+    uint32_t start;
+    uint32_t length;
+} RegistryIcon;
+
+typedef struct Registry {
+    char* blob; // NULL when streamed
+    uint32_t size;
+#if defined(REGISTRY_TAPE)
+    TapeEntry* tape;
+#else
+    cJSON* json;
+#endif
+    RegistryIcon* icons;
+    int icons_count;
+    char** icon_data; // icons read so far, when streamed
+    struct RegistryRangeIcons* range_icons; // icons read by {start, length} so far, when streamed
+} Registry;
+
+// Returns the registry, reading and parsing it through the host unless a pre-initialized
+// snapshot of the same registry is already in the heap.
+Registry* GetRegistry();
+
+// Returns the registry to run query against. Builds with -DREGISTRY_STREAMING stream it, see
+// registry_stream.h, and only keep the credentials that may match query. Others return
+// GetRegistry().
+Registry* GetRegistryForQuery(const cJSON* query);
+
+// Returns the "credentials" object of the registry json, the store dcql_query matches against.
+StoreRef GetRegistryCredentials(const Registry* registry);
+
+// Whether any credential query of the DCQL query may match a credential of the registry. Only the
+// summary is read, the answer is always yes for registries without one.
+int RegistryMayMatch(const cJSON* query);
+
+// Returns the icon of a registry entry as a pointer into the blob, without copying, or read
+// through the host once when the registry was streamed. Returns NULL
+// with a length of 0 if the entry has no icon or it does not fit in the blob.
+char* GetRegistryIcon(const Registry* registry, const cJSON* entry, int* icon_len);
+
+#endif
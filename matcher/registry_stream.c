@@ -0,0 +1,428 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "credentialmanager.h"
+#include "dcql.h"
+#include "registry_stream.h"
+
+// Streaming builds a cJSON store, see store.h
+#if !defined(REGISTRY_TAPE)
+
+typedef struct JsonStream {
+    char window[REGISTRY_STREAM_WINDOW];
+    uint32_t window_start; // blob offset of window[0]
+    uint32_t window_len;
+    uint32_t pos; // blob offset of the next character
+    uint32_t end;
+    int error;
+    // The current string or number token
+    char* text;
+    size_t text_len;
+    size_t text_cap;
+} JsonStream;
+
+static JsonStream stream;
+
+static int Peek(JsonStream* s) {
+    if (s->error || s->pos >= s->end) {
+        return -1;
+    }
+    if (s->pos >= s->window_start + s->window_len) {
+        uint32_t len = s->end - s->pos < REGISTRY_STREAM_WINDOW ? s->end - s->pos : REGISTRY_STREAM_WINDOW;
+        s->window_start = s->pos;
+        s->window_len = ReadCredentialsBuffer(s->window, s->pos, len);
+        if (s->window_len == 0) {
+            s->error = 1;
+            return -1;
+        }
+    }
+    return (unsigned char)s->window[s->pos - s->window_start];
+}
+
+static int Next(JsonStream* s) {
+    int c = Peek(s);
+    if (c >= 0) {
+        s->pos++;
+    }
+    return c;
+}
+
+static int SkipSpace(JsonStream* s) {
+    int c = Peek(s);
+    while (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+        s->pos++;
+        c = Peek(s);
+    }
+    return c;
+}
+
+static int Expect(JsonStream* s, char expected) {
+    if (SkipSpace(s) != expected) {
+        s->error = 1;
+        return 0;
+    }
+    s->pos++;
+    return 1;
+}
+
+static void TextAppend(JsonStream* s, char c) {
+    if (s->text_len + 1 >= s->text_cap) {
+        s->text_cap = s->text_cap == 0 ? 256 : s->text_cap * 2;
+        s->text = realloc(s->text, s->text_cap);
+    }
+    s->text[s->text_len++] = c;
+    s->text[s->text_len] = '\0';
+}
+
+static int ParseHex4(JsonStream* s, uint32_t* value) {
+    *value = 0;
+    for (int i = 0; i < 4; i++) {
+        int c = Next(s);
+        *value <<= 4;
+        if (c >= '0' && c <= '9') {
+            *value |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            *value |= c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            *value |= c - 'A' + 10;
+        } else {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void AppendUtf8(JsonStream* s, uint32_t codepoint) {
+    if (codepoint < 0x80) {
+        TextAppend(s, codepoint);
+    } else if (codepoint < 0x800) {
+        TextAppend(s, 0xc0 | (codepoint >> 6));
+        TextAppend(s, 0x80 | (codepoint & 0x3f));
+    } else if (codepoint < 0x10000) {
+        TextAppend(s, 0xe0 | (codepoint >> 12));
+        TextAppend(s, 0x80 | ((codepoint >> 6) & 0x3f));
+        TextAppend(s, 0x80 | (codepoint & 0x3f));
+    } else {
+        TextAppend(s, 0xf0 | (codepoint >> 18));
+        TextAppend(s, 0x80 | ((codepoint >> 12) & 0x3f));
+        TextAppend(s, 0x80 | ((codepoint >> 6) & 0x3f));
+        TextAppend(s, 0x80 | (codepoint & 0x3f));
+    }
+}
+
+// Reads a string into s->text, with the escapes decoded the way cJSON does.
+static int ParseString(JsonStream* s) {
+    if (!Expect(s, '"')) {
+        return 0;
+    }
+    s->text_len = 0;
+    TextAppend(s, '\0');
+    s->text_len = 0;
+    for (;;) {
+        int c = Next(s);
+        if (c < 0) {
+            s->error = 1;
+            return 0;
+        }
+        if (c == '"') {
+            return 1;
+        }
+        if (c != '\\') {
+            TextAppend(s, c);
+            continue;
+        }
+        c = Next(s);
+        uint32_t codepoint;
+        switch (c) {
+            case 'b': TextAppend(s, '\b'); break;
+            case 'f': TextAppend(s, '\f'); break;
+            case 'n': TextAppend(s, '\n'); break;
+            case 'r': TextAppend(s, '\r'); break;
+            case 't': TextAppend(s, '\t'); break;
+            case '"':
+            case '\\':
+            case '/':
+                TextAppend(s, c);
+                break;
+            case 'u':
+                if (!ParseHex4(s, &codepoint) || (codepoint >= 0xdc00 && codepoint <= 0xdfff)) {
+                    s->error = 1;
+                    return 0;
+                }
+                if (codepoint >= 0xd800 && codepoint <= 0xdbff) {
+                    uint32_t low;
+                    if (Next(s) != '\\' || Next(s) != 'u' || !ParseHex4(s, &low) || low < 0xdc00 || low > 0xdfff) {
+                        s->error = 1;
+                        return 0;
+                    }
+                    codepoint = 0x10000 + (((codepoint & 0x3ff) << 10) | (low & 0x3ff));
+                }
+                AppendUtf8(s, codepoint);
+                break;
+            default:
+                s->error = 1;
+                return 0;
+        }
+    }
+}
+
+// Reads a number or literal token into s->text.
+static void ParseBareToken(JsonStream* s) {
+    s->text_len = 0;
+    TextAppend(s, '\0');
+    s->text_len = 0;
+    int c = Peek(s);
+    while (c >= 0 && strchr(",}] \t\n\r", c) == NULL) {
+        TextAppend(s, c);
+        s->pos++;
+        c = Peek(s);
+    }
+}
+
+static cJSON* BuildValue(JsonStream* s, int depth);
+
+static cJSON* BuildBareValue(JsonStream* s) {
+    ParseBareToken(s);
+    if (strcmp(s->text, "true") == 0) {
+        return cJSON_CreateTrue();
+    } else if (strcmp(s->text, "false") == 0) {
+        return cJSON_CreateFalse();
+    } else if (strcmp(s->text, "null") == 0) {
+        return cJSON_CreateNull();
+    }
+    char* number_end;
+    double number = strtod(s->text, &number_end);
+    if (s->text_len == 0 || *number_end != '\0') {
+        s->error = 1;
+        return NULL;
+    }
+    return cJSON_CreateNumber(number);
+}
+
+// Iterates the members of an object or the elements of an array, after the opening bracket.
+// Returns 1 for the next item, with the key of a member in s->text, and 0 at the end.
+static int NextItem(JsonStream* s, char close, int* first) {
+    int c = SkipSpace(s);
+    if (c == close) {
+        s->pos++;
+        return 0;
+    }
+    if (!*first && !Expect(s, ',')) {
+        return 0;
+    }
+    *first = 0;
+    if (close == '}') {
+        return ParseString(s) && Expect(s, ':');
+    }
+    return !s->error;
+}
+
+static cJSON* BuildValue(JsonStream* s, int depth) {
+    if (depth > CJSON_NESTING_LIMIT) {
+        s->error = 1;
+        return NULL;
+    }
+    int c = SkipSpace(s);
+    if (c == '"') {
+        return ParseString(s) ? cJSON_CreateString(s->text) : NULL;
+    }
+    if (c != '{' && c != '[') {
+        return BuildBareValue(s);
+    }
+    s->pos++;
+    char close = c == '{' ? '}' : ']';
+    cJSON* item = close == '}' ? cJSON_CreateObject() : cJSON_CreateArray();
+    int first = 1;
+    while (NextItem(s, close, &first)) {
+        char* key = close == '}' ? strdup(s->text) : NULL;
+        cJSON* child = BuildValue(s, depth + 1);
+        if (child == NULL) {
+            free(key);
+            break;
+        }
+        if (key != NULL) {
+            cJSON_AddItemToObject(item, key, child);
+            free(key);
+        } else {
+            cJSON_AddItemToArray(item, child);
+        }
+    }
+    if (s->error) {
+        cJSON_Delete(item);
+        return NULL;
+    }
+    return item;
+}
+
+static void SkipValue(JsonStream* s, int depth) {
+    if (depth > CJSON_NESTING_LIMIT) {
+        s->error = 1;
+        return;
+    }
+    int c = SkipSpace(s);
+    if (c == '"') {
+        ParseString(s);
+        return;
+    }
+    if (c != '{' && c != '[') {
+        ParseBareToken(s);
+        return;
+    }
+    s->pos++;
+    char close = c == '{' ? '}' : ']';
+    int first = 1;
+    while (NextItem(s, close, &first)) {
+        SkipValue(s, depth + 1);
+    }
+}
+
+// Allocations of the per credential dcql_query runs go to an arena that is reset after each
+// credential, dcql_query leaves freeing its results to the end of the process.
+typedef struct ArenaChunk {
+    struct ArenaChunk* next;
+    size_t used;
+    size_t cap;
+} ArenaChunk;
+
+#define ARENA_CHUNK_SIZE 32768
+
+static ArenaChunk* arena;
+
+static void* CJSON_CDECL ArenaMalloc(size_t size) {
+    size = (size + 7) & ~(size_t)7;
+    if (arena == NULL || arena->used + size > arena->cap) {
+        size_t cap = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+        ArenaChunk* chunk = malloc(sizeof(ArenaChunk) + cap);
+        chunk->next = arena;
+        chunk->used = 0;
+        chunk->cap = cap;
+        arena = chunk;
+    }
+    void* p = (char*)(arena + 1) + arena->used;
+    arena->used += size;
+    return p;
+}
+
+static void CJSON_CDECL ArenaFree(void* p) {
+    (void)p;
+}
+
+// Frees all chunks but the last one allocated.
+static void ArenaReset() {
+    while (arena != NULL && arena->next != NULL) {
+        ArenaChunk* next = arena->next;
+        free(arena);
+        arena = next;
+    }
+    if (arena != NULL) {
+        arena->used = 0;
+    }
+}
+
+// Whether dcql_query finds credential when it is the only one of the store. Candidates are
+// matched independently of each other, so this is also whether it can contribute to the result
+// over the whole store.
+static int MayMatch(const cJSON* query, cJSON* credential, const char* format_key, const char* type_key) {
+    cJSON* store = cJSON_CreateObject();
+    cJSON* format_object = cJSON_AddObjectToObject(store, format_key);
+    cJSON* candidates = cJSON_AddArrayToObject(format_object, type_key);
+    cJSON_AddItemReferenceToArray(candidates, credential);
+
+    cJSON_Hooks hooks = {ArenaMalloc, ArenaFree};
+    cJSON_InitHooks(&hooks);
+    // On a copy, the query is not guaranteed to come out of dcql_query unchanged
+    int matched = cJSON_GetArraySize(dcql_query(cJSON_Duplicate(query, cJSON_True), store)) > 0;
+    cJSON_InitHooks(NULL);
+    ArenaReset();
+
+    cJSON_Delete(store);
+    return matched;
+}
+
+// credentials: {format: {type: [credential, ...]}}, anything of another shape is kept whole.
+static cJSON* StreamCredentials(JsonStream* s, const cJSON* query) {
+    if (SkipSpace(s) != '{') {
+        return BuildValue(s, 1);
+    }
+    s->pos++;
+    cJSON* credentials = cJSON_CreateObject();
+    int kept = 0;
+    int first_format = 1;
+    while (NextItem(s, '}', &first_format)) {
+        char* format_key = strdup(s->text);
+        cJSON* format;
+        if (SkipSpace(s) != '{') {
+            format = BuildValue(s, 2);
+        } else {
+            s->pos++;
+            format = cJSON_CreateObject();
+            int first_type = 1;
+            while (NextItem(s, '}', &first_type)) {
+                char* type_key = strdup(s->text);
+                cJSON* type_array;
+                if (SkipSpace(s) != '[') {
+                    type_array = BuildValue(s, 3);
+                } else {
+                    s->pos++;
+                    type_array = cJSON_CreateArray();
+                    int first_credential = 1;
+                    while (NextItem(s, ']', &first_credential)) {
+                        cJSON* credential = BuildValue(s, 4);
+                        if (credential == NULL) {
+                            break;
+                        }
+                        if (kept < REGISTRY_STREAM_MAX_KEPT && MayMatch(query, credential, format_key, type_key)) {
+                            cJSON_AddItemToArray(type_array, credential);
+                            kept++;
+                        } else {
+                            cJSON_Delete(credential);
+                        }
+                    }
+                }
+                if (type_array != NULL) {
+                    cJSON_AddItemToObject(format, type_key, type_array);
+                }
+                free(type_key);
+            }
+        }
+        if (format != NULL) {
+            cJSON_AddItemToObject(credentials, format_key, format);
+        }
+        free(format_key);
+    }
+    return credentials;
+}
+
+cJSON* StreamRegistry(const cJSON* query, uint32_t json_offset, uint32_t size) {
+    JsonStream* s = &stream;
+    s->window_start = 0;
+    s->window_len = 0;
+    s->pos = json_offset;
+    s->end = size;
+    s->error = 0;
+
+    cJSON* json = cJSON_CreateObject();
+    if (Expect(s, '{')) {
+        int first = 1;
+        while (NextItem(s, '}', &first)) {
+            if (strcmp(s->text, "credentials") == 0 && !cJSON_HasObjectItem(json, "credentials")) {
+                cJSON_AddItemToObject(json, "credentials", StreamCredentials(s, query));
+            } else if (strcmp(s->text, "icons") == 0 && !cJSON_HasObjectItem(json, "icons")) {
+                cJSON_AddItemToObject(json, "icons", BuildValue(s, 1));
+            } else {
+                SkipValue(s, 1);
+            }
+        }
+    }
+    free(s->text);
+    s->text = NULL;
+    s->text_len = 0;
+    s->text_cap = 0;
+    if (s->error) {
+        cJSON_Delete(json);
+        return NULL;
+    }
+    return json;
+}
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef REGISTRY_STREAM_H
+#define REGISTRY_STREAM_H
+
+#include <stdint.h>
+
+#include "cJSON/cJSON.h"
+
+// Streaming read of the registry json for devices that can't hold the blob and its full cJSON
+// tree at the same time. The json is read through ReadCredentialsBuffer in windows of
+// REGISTRY_STREAM_WINDOW bytes and parsed by a pull parser. Each credential is built on its own,
+// checked against the query and dropped unless it may match, so memory stays bounded by the
+// window, the largest credential and REGISTRY_STREAM_MAX_KEPT credentials.
+#define REGISTRY_STREAM_WINDOW 16384
+
+// The matching credentials kept at most, in registry order. Credentials matching past it are
+// dropped and not offered, the cost of a peak that doesn't grow with the wallet.
+#ifndef REGISTRY_STREAM_MAX_KEPT
+#define REGISTRY_STREAM_MAX_KEPT 256
+#endif
+
+// Returns the registry json with the same "credentials" layout, every format and type key kept,
+// but only the first REGISTRY_STREAM_MAX_KEPT credentials that dcql_query finds for query. The "icons" table is kept as is and
+// everything else is skipped. Returns NULL if the json is malformed.
+cJSON* StreamRegistry(const cJSON* query, uint32_t json_offset, uint32_t size);
+
+#endif
@@ -0,0 +1,197 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "request_scan.h"
+
+static const char* SkipSpace(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+        p++;
+    }
+    return p;
+}
+
+// p is at the opening quote. Returns the position after the closing quote, or NULL.
+static const char* SkipString(const char* p, const char* end) {
+    for (p++; p < end; p++) {
+        if (*p == '\\') {
+            p++;
+        } else if (*p == '"') {
+            return p + 1;
+        }
+    }
+    return NULL;
+}
+
+// Returns the position after the value at p, or NULL. Nested values are only matched up by
+// their brackets, they are validated when a span is parsed.
+static const char* SkipValue(const char* p, const char* end) {
+    if (p >= end) {
+        return NULL;
+    }
+    if (*p == '"') {
+        return SkipString(p, end);
+    }
+    if (*p == '{' || *p == '[') {
+        int depth = 0;
+        while (p < end) {
+            if (*p == '"') {
+                p = SkipString(p, end);
+                if (p == NULL) {
+                    return NULL;
+                }
+                continue;
+            }
+            if (*p == '{' || *p == '[') {
+                depth++;
+            } else if (*p == '}' || *p == ']') {
+                depth--;
+                if (depth == 0) {
+                    return p + 1;
+                }
+            }
+            p++;
+        }
+        return NULL;
+    }
+    // Numbers and literals
+    const char* start = p;
+    while (p < end && strchr(",}] \t\n\r", *p) == NULL) {
+        p++;
+    }
+    return p == start ? NULL : p;
+}
+
+// Iterates the members of an object or the elements of an array, *p starts after the opening
+// bracket. Returns 1 for the next member, 0 at the closing bracket and -1 if malformed. key is
+// left untouched for arrays.
+static int NextItem(const char** p, const char* end, JsonSpan* key, JsonSpan* value) {
+    const char* q = SkipSpace(*p, end);
+    if (q < end && (*q == '}' || *q == ']')) {
+        *p = q + 1;
+        return 0;
+    }
+    if (q < end && *q == ',') {
+        q = SkipSpace(q + 1, end);
+    }
+    if (key != NULL) {
+        if (q >= end || *q != '"') {
+            return -1;
+        }
+        const char* key_end = SkipString(q, end);
+        if (key_end == NULL) {
+            return -1;
+        }
+        key->start = q + 1;
+        key->len = key_end - q - 2;
+        q = SkipSpace(key_end, end);
+        if (q >= end || *q != ':') {
+            return -1;
+        }
+        q = SkipSpace(q + 1, end);
+    }
+    const char* value_end = SkipValue(q, end);
+    if (value_end == NULL) {
+        return -1;
+    }
+    value->start = q;
+    value->len = value_end - q;
+    *p = value_end;
+    return 1;
+}
+
+static int KeyIs(JsonSpan key, const char* name) {
+    return key.len == strlen(name) && memcmp(key.start, name, key.len) == 0;
+}
+
+// Like cJSON_GetObjectItem the first of duplicate members wins.
+static void ScanRequest(JsonSpan request, const char* data_key, ScannedRequest* scanned) {
+    memset(scanned, 0, sizeof(ScannedRequest));
+    if (request.len == 0 || request.start[0] != '{') {
+        return;
+    }
+    const char* p = request.start + 1;
+    const char* end = request.start + request.len;
+    JsonSpan key;
+    JsonSpan value;
+    while (NextItem(&p, end, &key, &value) == 1) {
+        if (scanned->protocol.len == 0 && KeyIs(key, "protocol")) {
+            scanned->protocol = value;
+        } else if (scanned->data.len == 0 && KeyIs(key, data_key)) {
+            scanned->data = value;
+        }
+    }
+}
+
+int ScanRequests(const char* json, size_t len, ScannedRequest** requests) {
+    *requests = NULL;
+    const char* end = json + len;
+    const char* p = SkipSpace(json, end);
+    if (p >= end || *p != '{') {
+        return -1;
+    }
+    p++;
+    JsonSpan list = {NULL, 0};
+    JsonSpan providers = {NULL, 0};
+    JsonSpan key;
+    JsonSpan value;
+    int status;
+    while ((status = NextItem(&p, end, &key, &value)) == 1) {
+        if (list.len == 0 && KeyIs(key, "requests")) {
+            list = value;
+        } else if (providers.len == 0 && KeyIs(key, "providers")) {
+            providers = value;
+        }
+    }
+    if (status < 0) {
+        return -1;
+    }
+    const char* data_key = "data";
+    if (list.len == 0) { // Legacy spec
+        list = providers;
+        data_key = "request";
+    }
+    if (list.len == 0 || list.start[0] != '[') {
+        return 0;
+    }
+
+    int count = 0;
+    int capacity = 0;
+    p = list.start + 1;
+    end = list.start + list.len;
+    while ((status = NextItem(&p, end, NULL, &value)) == 1) {
+        if (count == capacity) {
+            capacity = capacity == 0 ? 4 : capacity * 2;
+            *requests = realloc(*requests, sizeof(ScannedRequest) * capacity);
+        }
+        ScanRequest(value, data_key, &(*requests)[count++]);
+    }
+    return status < 0 ? -1 : count;
+}
+
+int SpanIsString(JsonSpan span, const char* value) {
+    size_t value_len = strlen(value);
+    if (span.len < 2 || span.start[0] != '"') {
+        return 0;
+    }
+    if (memchr(span.start, '\\', span.len) == NULL) {
+        return span.len == value_len + 2 && memcmp(span.start + 1, value, value_len) == 0;
+    }
+    // Escaped, leave the decoding to cJSON
+    cJSON* string = cJSON_ParseWithLength(span.start, span.len);
+    int equal = cJSON_IsString(string) && strcmp(string->valuestring, value) == 0;
+    cJSON_Delete(string);
+    return equal;
+}
+
+cJSON* ParseRequestData(JsonSpan data) {
+    if (data.len == 0) {
+        return NULL;
+    }
+    if (data.start[0] != '"') {
+        return cJSON_ParseWithLength(data.start, data.len);
+    }
+    cJSON* string = cJSON_ParseWithLength(data.start, data.len);
+    cJSON* parsed = cJSON_Parse(cJSON_GetStringValue(string));
+    cJSON_Delete(string);
+    return parsed;
+}
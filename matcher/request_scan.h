@@ -0,0 +1,34 @@
+#ifndef REQUEST_SCAN_H
+#define REQUEST_SCAN_H
+
+#include <stddef.h>
+
+#include "cJSON/cJSON.h"
+
+// Triage of a Digital Credentials request. The top level is scanned without building a cJSON
+// tree so that the data of protocols a matcher does not handle, e.g. an org-iso-mdoc
+// DeviceRequest next to the OpenID4VP request, is skipped over instead of parsed.
+
+// A raw JSON value inside the request buffer, len is 0 if the member is missing.
+typedef struct JsonSpan {
+    const char* start;
+    size_t len;
+} JsonSpan;
+
+typedef struct ScannedRequest {
+    JsonSpan protocol;
+    JsonSpan data; // "data" of requests, "request" of legacy providers
+} ScannedRequest;
+
+// Scans the "requests", or legacy "providers", of the request in json. Returns their number and
+// stores them in *requests, or returns -1 if the request is malformed.
+int ScanRequests(const char* json, size_t len, ScannedRequest** requests);
+
+// Whether span is a JSON string equal to value.
+int SpanIsString(JsonSpan span, const char* value);
+
+// Parses only the data span. Data given as a JSON string, as in the legacy spec, is parsed from
+// the string's contents.
+cJSON* ParseRequestData(JsonSpan data);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef STORE_H
+#define STORE_H
+
+#include "cJSON/cJSON.h"
+
+// Read access to the registry json, the credential store that dcql_query matches against. Builds
+// with -DREGISTRY_TAPE hold it as a tape, see tape.h, others as a cJSON tree. Only the store goes
+// through these, queries and results stay cJSON: store values are added to results by reference
+// to the tree, or as cJSON views of the tape sharing its strings.
+#if defined(REGISTRY_TAPE)
+#if defined(REGISTRY_STREAMING)
+#error "REGISTRY_TAPE and REGISTRY_STREAMING can't be combined"
+#endif
+
+#include "tape.h"
+
+typedef const TapeEntry* StoreRef;
+
+#define StoreGetObjectItem TapeGetObjectItem
+#define StoreGetObjectItemCaseSensitive TapeGetObjectItemCaseSensitive
+#define StoreHasObjectItem TapeHasObjectItem
+#define StoreIsNumber TapeIsNumber
+#define StoreIsArray TapeIsArray
+#define StoreIsObject TapeIsObject
+#define StoreGetNumberValue TapeGetNumberValue
+#define StoreGetStringValue TapeGetStringValue
+#define StoreGetArraySize TapeGetArraySize
+#define StoreGetArrayItem TapeGetArrayItem
+#define StoreArrayForEach TapeArrayForEach
+#define StoreFirstChild TapeFirstChild
+#define StoreNextChild TapeNextChild
+#define StoreCompare(json, item) TapeCompareJson(item, json)
+#define StoreAddItemToArray(array, item) cJSON_AddItemToArray(array, TapeToJson(item))
+#define StoreAddItemToObject(object, key, item) cJSON_AddItemToObject(object, key, TapeToJson(item))
+#else
+typedef cJSON* StoreRef;
+
+#define StoreGetObjectItem cJSON_GetObjectItem
+#define StoreGetObjectItemCaseSensitive cJSON_GetObjectItemCaseSensitive
+#define StoreHasObjectItem cJSON_HasObjectItem
+#define StoreIsNumber cJSON_IsNumber
+#define StoreIsArray cJSON_IsArray
+#define StoreIsObject cJSON_IsObject
+#define StoreGetNumberValue cJSON_GetNumberValue
+#define StoreGetStringValue cJSON_GetStringValue
+#define StoreGetArraySize cJSON_GetArraySize
+#define StoreGetArrayItem cJSON_GetArrayItem
+#define StoreArrayForEach cJSON_ArrayForEach
+#define StoreFirstChild(container) ((container) != NULL ? (container)->child : NULL)
+#define StoreNextChild(container, child) ((child)->next)
+#define StoreCompare(json, item) cJSON_Compare(json, item, cJSON_True)
+#define StoreAddItemToArray cJSON_AddItemReferenceToArray
+#define StoreAddItemToObject cJSON_AddItemReferenceToObject
+#endif
+
+#endif
@@ -0,0 +1,430 @@
+#include <float.h>
+#include <stdlib.h>
+#include <strings.h>
+
+#include "tape.h"
+
+typedef struct TapeBuilder {
+    const unsigned char* p;
+    TapeEntry* entries;
+    uint32_t count;
+    uint32_t cap;
+    char* strings;
+    size_t strings_len;
+    size_t strings_cap;
+} TapeBuilder;
+
+static int Reserve(void** data, size_t* cap, size_t needed, size_t item_size) {
+    if (needed <= *cap) {
+        return 1;
+    }
+    size_t new_cap = *cap == 0 ? 256 : *cap;
+    while (new_cap < needed) {
+        new_cap *= 2;
+    }
+    void* new_data = realloc(*data, new_cap * item_size);
+    if (new_data == NULL) {
+        return 0;
+    }
+    *data = new_data;
+    *cap = new_cap;
+    return 1;
+}
+
+static TapeEntry* Push(TapeBuilder* b, uint32_t slots) {
+    size_t cap = b->cap;
+    if (b->count + slots > TAPE_MAX_ENTRIES ||
+        !Reserve((void**)&b->entries, &cap, b->count + slots, sizeof(TapeEntry))) {
+        return NULL;
+    }
+    b->cap = cap;
+    TapeEntry* entry = &b->entries[b->count];
+    b->count += slots;
+    return entry;
+}
+
+static void SkipWhitespace(TapeBuilder* b) {
+    while (*b->p != '\0' && *b->p <= 32) {
+        b->p++;
+    }
+}
+
+static int ParseHex4(const unsigned char* p, uint32_t* value) {
+    *value = 0;
+    for (int i = 0; i < 4; i++) {
+        unsigned char c = p[i];
+        *value <<= 4;
+        if (c >= '0' && c <= '9') {
+            *value |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            *value |= c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            *value |= c - 'A' + 10;
+        } else {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Appends the UTF-8 encoding of the \u escape at p, one or two of them for a surrogate pair,
+// and returns the number of input bytes used or 0 if it is invalid.
+static int ParseUnicodeEscape(const unsigned char* p, char* out, int* out_len) {
+    uint32_t code_point;
+    int used = 6;
+    if (!ParseHex4(p + 2, &code_point) || (code_point >= 0xDC00 && code_point <= 0xDFFF)) {
+        return 0;
+    }
+    if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+        uint32_t low;
+        if (p[6] != '\\' || p[7] != 'u' || !ParseHex4(p + 8, &low) || low < 0xDC00 || low > 0xDFFF) {
+            return 0;
+        }
+        code_point = 0x10000 + (((code_point & 0x3FF) << 10) | (low & 0x3FF));
+        used = 12;
+    }
+    if (code_point < 0x80) {
+        out[0] = code_point;
+        *out_len = 1;
+    } else if (code_point < 0x800) {
+        out[0] = 0xC0 | (code_point >> 6);
+        out[1] = 0x80 | (code_point & 0x3F);
+        *out_len = 2;
+    } else if (code_point < 0x10000) {
+        out[0] = 0xE0 | (code_point >> 12);
+        out[1] = 0x80 | ((code_point >> 6) & 0x3F);
+        out[2] = 0x80 | (code_point & 0x3F);
+        *out_len = 3;
+    } else {
+        out[0] = 0xF0 | (code_point >> 18);
+        out[1] = 0x80 | ((code_point >> 12) & 0x3F);
+        out[2] = 0x80 | ((code_point >> 6) & 0x3F);
+        out[3] = 0x80 | (code_point & 0x3F);
+        *out_len = 4;
+    }
+    return used;
+}
+
+// Parses the string at the current position into the string arena. The entry holds the arena
+// offset until TapeParse turns it into one relative to the entry.
+static int ParseString(TapeBuilder* b) {
+    const unsigned char* end = b->p + 1;
+    while (*end != '"') {
+        if (*end == '\0') {
+            return 0;
+        }
+        if (*end == '\\') {
+            if (end[1] == '\0') {
+                return 0;
+            }
+            end++;
+        }
+        end++;
+    }
+    // Unescaping never makes a string longer
+    size_t needed = b->strings_len + (end - b->p);
+    if (needed > UINT32_MAX / 2 || !Reserve((void**)&b->strings, &b->strings_cap, needed, 1)) {
+        return 0;
+    }
+    TapeEntry* entry = Push(b, 1);
+    if (entry == NULL) {
+        return 0;
+    }
+    entry->tag = TAPE_STRING | (1 << 4);
+    entry->value = b->strings_len;
+    char* out = b->strings + b->strings_len;
+    const unsigned char* p = b->p + 1;
+    while (p < end) {
+        if (*p != '\\') {
+            *out++ = *p++;
+            continue;
+        }
+        int len = 1;
+        switch (p[1]) {
+            case 'b': *out = '\b'; break;
+            case 'f': *out = '\f'; break;
+            case 'n': *out = '\n'; break;
+            case 'r': *out = '\r'; break;
+            case 't': *out = '\t'; break;
+            case '"':
+            case '\\':
+            case '/':
+                *out = p[1];
+                break;
+            case 'u': {
+                int used = ParseUnicodeEscape(p, out, &len);
+                if (used == 0 || p + used > end) {
+                    return 0;
+                }
+                out += len;
+                p += used;
+                continue;
+            }
+            default:
+                return 0;
+        }
+        out += len;
+        p += 2;
+    }
+    *out++ = '\0';
+    b->strings_len = out - b->strings;
+    b->p = end + 1;
+    return 1;
+}
+
+// Numbers are read the way cJSON reads them, with strtod over the characters a number may have.
+static int ParseNumber(TapeBuilder* b) {
+    char buffer[64];
+    size_t len = 0;
+    while (len < sizeof(buffer) - 1 && b->p[len] != '\0' && strchr("0123456789+-eE.", b->p[len]) != NULL) {
+        buffer[len] = b->p[len];
+        len++;
+    }
+    buffer[len] = '\0';
+    char* end;
+    double number = strtod(buffer, &end);
+    if (end == buffer) {
+        return 0;
+    }
+    TapeEntry* entry = Push(b, 2);
+    if (entry == NULL) {
+        return 0;
+    }
+    entry->tag = TAPE_NUMBER | (2 << 4);
+    entry->value = 0;
+    memcpy(entry + 1, &number, sizeof(number));
+    b->p += end - buffer;
+    return 1;
+}
+
+static int ParseLiteral(TapeBuilder* b, const char* literal, int type) {
+    size_t len = strlen(literal);
+    if (strncmp((const char*)b->p, literal, len) != 0) {
+        return 0;
+    }
+    TapeEntry* entry = Push(b, 1);
+    if (entry == NULL) {
+        return 0;
+    }
+    entry->tag = type | (1 << 4);
+    entry->value = 0;
+    b->p += len;
+    return 1;
+}
+
+// Containers are parsed without recursion. While a container is open its span holds the index
+// of the enclosing one plus one, and its value the number of elements so far.
+static int ParseDocument(TapeBuilder* b) {
+    uint32_t open = 0; // index of the innermost open container plus one, 0 at the top level
+    for (;;) {
+        SkipWhitespace(b);
+        int opened = 0;
+        if (*b->p == '{' || *b->p == '[') {
+            TapeEntry* entry = Push(b, 1);
+            if (entry == NULL) {
+                return 0;
+            }
+            entry->tag = (*b->p == '{' ? TAPE_OBJECT : TAPE_ARRAY) | (open << 4);
+            entry->value = 0;
+            open = b->count;
+            opened = 1;
+            b->p++;
+        } else if (*b->p == '"') {
+            if (!ParseString(b)) {
+                return 0;
+            }
+        } else if (*b->p == '-' || (*b->p >= '0' && *b->p <= '9')) {
+            if (!ParseNumber(b)) {
+                return 0;
+            }
+        } else if (!ParseLiteral(b, "null", TAPE_NULL) && !ParseLiteral(b, "false", TAPE_FALSE) &&
+                   !ParseLiteral(b, "true", TAPE_TRUE)) {
+            return 0;
+        }
+
+        // Close containers until the next value is due
+        for (;;) {
+            if (open == 0) {
+                return 1;
+            }
+            TapeEntry* container = &b->entries[open - 1];
+            int is_object = (container->tag & 0xf) == TAPE_OBJECT;
+            SkipWhitespace(b);
+            if (*b->p == (is_object ? '}' : ']')) {
+                b->p++;
+                uint32_t enclosing = container->tag >> 4;
+                container->tag = (container->tag & 0xf) | ((b->count - (open - 1)) << 4);
+                open = enclosing;
+                opened = 0;
+                continue;
+            }
+            if (!opened) {
+                if (*b->p != ',') {
+                    return 0;
+                }
+                b->p++;
+            }
+            container->value++;
+            if (is_object) {
+                SkipWhitespace(b);
+                if (*b->p != '"' || !ParseString(b)) {
+                    return 0;
+                }
+                SkipWhitespace(b);
+                if (*b->p != ':') {
+                    return 0;
+                }
+                b->p++;
+            }
+            break;
+        }
+    }
+}
+
+TapeEntry* TapeParse(const char* json) {
+    if (json == NULL) {
+        return NULL;
+    }
+    TapeBuilder b = {(const unsigned char*)json, NULL, 0, 0, NULL, 0, 0};
+    if (strncmp(json, "\xEF\xBB\xBF", 3) == 0) {
+        b.p += 3;
+    }
+    TapeEntry* tape = NULL;
+    size_t entries_size = 0;
+    if (ParseDocument(&b)) {
+        entries_size = (size_t)b.count * sizeof(TapeEntry);
+        if (entries_size + b.strings_len <= UINT32_MAX) {
+            // The strings go after the entries, in place when the allocator can grow them
+            tape = realloc(b.entries, entries_size + b.strings_len);
+        }
+    }
+    if (tape == NULL) {
+        free(b.entries);
+        free(b.strings);
+        return NULL;
+    }
+    if (b.strings_len > 0) {
+        memcpy((char*)tape + entries_size, b.strings, b.strings_len);
+    }
+    free(b.strings);
+    for (uint32_t i = 0; i < b.count; i += TapeIsNumber(&tape[i]) ? 2 : 1) {
+        if (TapeIsString(&tape[i])) {
+            tape[i].value += (b.count - i) * sizeof(TapeEntry);
+        }
+    }
+    return tape;
+}
+
+const TapeEntry* TapeGetObjectItem(const TapeEntry* object, const char* key) {
+    const TapeEntry* member;
+    if (key == NULL || !TapeIsObject(object)) {
+        return NULL;
+    }
+    TapeArrayForEach(member, object) {
+        if (strcasecmp(key, TapeGetKey(member)) == 0) {
+            return member;
+        }
+    }
+    return NULL;
+}
+
+const TapeEntry* TapeGetObjectItemCaseSensitive(const TapeEntry* object, const char* key) {
+    const TapeEntry* member;
+    if (key == NULL || !TapeIsObject(object)) {
+        return NULL;
+    }
+    TapeArrayForEach(member, object) {
+        if (strcmp(key, TapeGetKey(member)) == 0) {
+            return member;
+        }
+    }
+    return NULL;
+}
+
+static int JsonType(const cJSON* json) {
+    switch (json->type & 0xff) {
+        case cJSON_NULL: return TAPE_NULL;
+        case cJSON_False: return TAPE_FALSE;
+        case cJSON_True: return TAPE_TRUE;
+        case cJSON_Number: return TAPE_NUMBER;
+        case cJSON_String: return TAPE_STRING;
+        case cJSON_Array: return TAPE_ARRAY;
+        case cJSON_Object: return TAPE_OBJECT;
+        default: return 0;
+    }
+}
+
+int TapeCompareJson(const TapeEntry* item, const cJSON* json) {
+    if (item == NULL || json == NULL || JsonType(json) != TapeType(item)) {
+        return 0;
+    }
+    switch (TapeType(item)) {
+        case TAPE_NUMBER: {
+            double a = json->valuedouble;
+            double b = TapeGetNumberValue(item);
+            double max = fabs(a) > fabs(b) ? fabs(a) : fabs(b);
+            return fabs(a - b) <= max * DBL_EPSILON;
+        }
+        case TAPE_STRING:
+            return json->valuestring != NULL && strcmp(json->valuestring, TapeGetStringValue(item)) == 0;
+        case TAPE_ARRAY: {
+            const TapeEntry* element = TapeFirstChild(item);
+            const cJSON* json_element = json->child;
+            for (; element != NULL && json_element != NULL; element = TapeNextChild(item, element)) {
+                if (!TapeCompareJson(element, json_element)) {
+                    return 0;
+                }
+                json_element = json_element->next;
+            }
+            return element == NULL && json_element == NULL;
+        }
+        case TAPE_OBJECT: {
+            const cJSON* json_member;
+            cJSON_ArrayForEach(json_member, json) {
+                if (!TapeCompareJson(TapeGetObjectItemCaseSensitive(item, json_member->string), json_member)) {
+                    return 0;
+                }
+            }
+            const TapeEntry* member;
+            TapeArrayForEach(member, item) {
+                if (!TapeCompareJson(member, cJSON_GetObjectItemCaseSensitive(json, TapeGetKey(member)))) {
+                    return 0;
+                }
+            }
+            return 1;
+        }
+        default:
+            return 1;
+    }
+}
+
+cJSON* TapeToJson(const TapeEntry* item) {
+    cJSON* json = NULL;
+    const TapeEntry* element;
+    switch (TapeType(item)) {
+        case TAPE_NULL:
+            return cJSON_CreateNull();
+        case TAPE_FALSE:
+            return cJSON_CreateFalse();
+        case TAPE_TRUE:
+            return cJSON_CreateTrue();
+        case TAPE_NUMBER:
+            return cJSON_CreateNumber(TapeGetNumberValue(item));
+        case TAPE_STRING:
+            return cJSON_CreateStringReference(TapeGetStringValue(item));
+        case TAPE_ARRAY:
+            json = cJSON_CreateArray();
+            TapeArrayForEach(element, item) {
+                cJSON_AddItemToArray(json, TapeToJson(element));
+            }
+            return json;
+        case TAPE_OBJECT:
+            json = cJSON_CreateObject();
+            TapeArrayForEach(element, item) {
+                cJSON_AddItemToObjectCS(json, TapeGetKey(element), TapeToJson(element));
+            }
+            return json;
+        default:
+            return NULL;
+    }
+}
@@ -0,0 +1,131 @@
+#ifndef TAPE_H
+#define TAPE_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cJSON/cJSON.h"
+
+// Read-only json document laid out as one allocation instead of a tree of cJSON nodes, for the
+// registry. Values are 8 byte entries in document order, followed by the strings they use:
+//
+// |---------------------------------------|
+// |- (u32) type | span << 4, (u32) value -|
+// |------------- More Entries... ---------|
+// |-------- NUL terminated strings -------|
+// |---------------------------------------|
+//
+// The span is the number of entries a value takes, so skipping a value is one addition. Arrays
+// and objects are followed by their elements, an object member being its key, a TAPE_STRING,
+// then its value. Their value field is the number of elements. Strings hold the byte offset of
+// their text from the entry itself, which keeps every entry usable without the tape it is part
+// of. Numbers take a second entry holding the double.
+#define TAPE_NULL 1
+#define TAPE_FALSE 2
+#define TAPE_TRUE 3
+#define TAPE_NUMBER 4
+#define TAPE_STRING 5
+#define TAPE_ARRAY 6
+#define TAPE_OBJECT 7
+
+#define TAPE_MAX_ENTRIES 0x0fffffff
+
+typedef struct TapeEntry {
+    uint32_t tag;
+    uint32_t value;
+} TapeEntry;
+
+// Parses json into a new tape to be released with free(), its root value being the first entry.
+// Accepts what cJSON_Parse accepts for documents without nesting limits and returns NULL for
+// anything else.
+TapeEntry* TapeParse(const char* json);
+
+// The accessors mirror their cJSON counterparts and accept NULL for a missing value.
+static inline int TapeType(const TapeEntry* item) {
+    return item == NULL ? 0 : item->tag & 0xf;
+}
+
+static inline uint32_t TapeSpan(const TapeEntry* item) {
+    return item->tag >> 4;
+}
+
+static inline int TapeIsNumber(const TapeEntry* item) {
+    return TapeType(item) == TAPE_NUMBER;
+}
+
+static inline int TapeIsString(const TapeEntry* item) {
+    return TapeType(item) == TAPE_STRING;
+}
+
+static inline int TapeIsArray(const TapeEntry* item) {
+    return TapeType(item) == TAPE_ARRAY;
+}
+
+static inline int TapeIsObject(const TapeEntry* item) {
+    return TapeType(item) == TAPE_OBJECT;
+}
+
+static inline const char* TapeGetStringValue(const TapeEntry* item) {
+    return TapeIsString(item) ? (const char*)item + item->value : NULL;
+}
+
+static inline double TapeGetNumberValue(const TapeEntry* item) {
+    double value = NAN;
+    if (TapeIsNumber(item)) {
+        memcpy(&value, item + 1, sizeof(value));
+    }
+    return value;
+}
+
+static inline int TapeGetArraySize(const TapeEntry* item) {
+    return TapeIsArray(item) || TapeIsObject(item) ? (int)item->value : 0;
+}
+
+static inline const TapeEntry* TapeFirstChild(const TapeEntry* container) {
+    if (TapeGetArraySize(container) == 0) {
+        return NULL;
+    }
+    return TapeIsObject(container) ? container + 2 : container + 1;
+}
+
+// The element after child, for child an element of container.
+static inline const TapeEntry* TapeNextChild(const TapeEntry* container, const TapeEntry* child) {
+    const TapeEntry* next = child + TapeSpan(child);
+    if (next >= container + TapeSpan(container)) {
+        return NULL;
+    }
+    return TapeIsObject(container) ? next + 1 : next;
+}
+
+static inline const TapeEntry* TapeGetArrayItem(const TapeEntry* array, int index) {
+    const TapeEntry* element = index >= 0 && TapeIsArray(array) ? TapeFirstChild(array) : NULL;
+    while (element != NULL && index-- > 0) {
+        element = TapeNextChild(array, element);
+    }
+    return element;
+}
+
+// Iterates the elements of an array or the member values of an object, like cJSON_ArrayForEach.
+#define TapeArrayForEach(element, container) \
+    for (element = TapeFirstChild(container); element != NULL; element = TapeNextChild(container, element))
+
+// The key of a member value of an object.
+static inline const char* TapeGetKey(const TapeEntry* member) {
+    return TapeGetStringValue(member - 1);
+}
+
+const TapeEntry* TapeGetObjectItem(const TapeEntry* object, const char* key);
+const TapeEntry* TapeGetObjectItemCaseSensitive(const TapeEntry* object, const char* key);
+
+static inline int TapeHasObjectItem(const TapeEntry* object, const char* key) {
+    return TapeGetObjectItem(object, key) != NULL;
+}
+
+// cJSON_Compare(json, item, cJSON_True) for a cJSON value against a tape value.
+int TapeCompareJson(const TapeEntry* item, const cJSON* json);
+
+// Returns item as cJSON, with its strings and keys referencing the tape rather than copied.
+cJSON* TapeToJson(const TapeEntry* item);
+
+#endif
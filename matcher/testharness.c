@@ -1,45 +1,441 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
+#define CREDMAN_HOST_IMPL
 #include "credentialmanager.h"
 
+#include "base64.h"
+#include "batch.h"
+#include "trace.h"
+
 #define REQUEST_PATH "request.json"
 #define CREDS_PATH "testcreds.json"
 
-void GetFileSize(const char* path, uint32_t* size) {
+// The paths and the output of the host shim can be overridden through the environment so that
+// tools such as difftest.py can drive any matcher binary without recompiling it:
+//   CREDMAN_REQUEST_PATH  request json served through GetRequestBuffer
+//   CREDMAN_CREDS_PATH    registry blob served through ReadCredentialsBuffer
+//   CREDMAN_CALLS_PATH    file receiving one line per emitted host call (defaults to stdout)
+//   CREDMAN_CALLING_PACKAGE / CREDMAN_CALLING_ORIGIN  returned by GetCallingAppInfo
+//   CREDMAN_REPLAY_PATH   trace captured with -DCREDMAN_TRACE, see Replay below
+//   CREDMAN_NO_BATCH      declines AddEntriesBatch, to exercise the per-entry fallback
+//   CREDMAN_HOST_LATENCY_US  time spent in every host call, see HostCall below
+//   CREDMAN_HOST_STATS    prints the number of host calls and credential bytes read on exit
+
+static const char* GetEnvOr(const char* name, const char* fallback) {
+    const char* value = getenv(name);
+    return value != NULL ? value : fallback;
+}
+
+static FILE* CallsFile() {
+    static FILE* calls = NULL;
+    if (calls == NULL) {
+        const char* path = getenv("CREDMAN_CALLS_PATH");
+        calls = path != NULL ? fopen(path, "w") : stdout;
+        if (calls == NULL) {
+            calls = stdout;
+        }
+    }
+    return calls;
+}
+
+// Call records are tab separated, so escape the few characters that would break a line apart.
+static void PrintField(const char* value) {
+    FILE* calls = CallsFile();
+    fputc('\t', calls);
+    if (value == NULL) {
+        fputs("(null)", calls);
+        return;
+    }
+    for (const char* c = value; *c != '\0'; c++) {
+        switch (*c) {
+            case '\t': fputs("\\t", calls); break;
+            case '\n': fputs("\\n", calls); break;
+            case '\\': fputs("\\\\", calls); break;
+            default: fputc(*c, calls);
+        }
+    }
+}
+
+// Icons are reduced to their length and an FNV-1a digest to keep the records short.
+static void PrintIcon(const char* icon, size_t icon_len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; icon != NULL && i < icon_len; i++) {
+        hash ^= (uint8_t)icon[i];
+        hash *= 16777619u;
+    }
+    fprintf(CallsFile(), "\t%zu:%08x", icon_len, hash);
+}
+
+static void EndRecord() {
+    fputc('\n', CallsFile());
+    fflush(CallsFile());
+}
+
+// The request and the registry are mapped once per run, so that reading the registry in many
+// small ranges costs what it costs on a device rather than a file open per call.
+typedef struct MappedFile {
+    const char* data;
+    uint32_t len;
+} MappedFile;
+
+static void MapFile(const char* path, MappedFile* file) {
+    file->data = NULL;
+    file->len = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
     struct stat s;
-    stat(path, &s);
-    *size = s.st_size;
+    if (fstat(fd, &s) == 0 && s.st_size > 0) {
+        void* data = mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            file->data = data;
+            file->len = s.st_size;
+        }
+    }
+    close(fd);
+}
+
+static const MappedFile* RequestFile() {
+    static MappedFile request;
+    static int mapped = 0;
+    if (!mapped) {
+        MapFile(GetEnvOr("CREDMAN_REQUEST_PATH", REQUEST_PATH), &request);
+        mapped = 1;
+    }
+    return &request;
+}
+
+static const MappedFile* CredsFile() {
+    static MappedFile creds;
+    static int mapped = 0;
+    if (!mapped) {
+        MapFile(GetEnvOr("CREDMAN_CREDS_PATH", CREDS_PATH), &creds);
+        mapped = 1;
+    }
+    return &creds;
+}
+
+// Every host call crosses the wasm boundary into Credential Manager on a device. The crossing
+// is simulated by spinning for CREDMAN_HOST_LATENCY_US, entries decoded from a batch count as
+// part of their AddEntriesBatch call.
+typedef struct HostStats {
+    int calls;
+    int credential_reads;
+    size_t credential_bytes;
+} HostStats;
+
+static HostStats host_stats;
+static int in_batch = 0;
+
+static void ReportHostStats(void) {
+    fprintf(stderr, "host: %d calls, %d credential reads, %zu credential bytes\n",
+            host_stats.calls, host_stats.credential_reads, host_stats.credential_bytes);
+}
+
+static void HostCall() {
+    static double latency_us = -1;
+    if (latency_us < 0) {
+        latency_us = atof(GetEnvOr("CREDMAN_HOST_LATENCY_US", "0"));
+        if (getenv("CREDMAN_HOST_STATS") != NULL) {
+            atexit(ReportHostStats);
+        }
+    }
+    if (in_batch) {
+        return;
+    }
+    host_stats.calls++;
+    if (latency_us <= 0) {
+        return;
+    }
+    struct timespec start;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while ((now.tv_sec - start.tv_sec) * 1e6 + (now.tv_nsec - start.tv_nsec) / 1e3 < latency_us);
+}
+
+// Replay of a captured trace. The request, the recorded registry ranges and the calling app are
+// served back bit for bit, every emitted call is checked against the recorded one, and the run is
+// timed from the end of trace loading until the matcher returns.
+typedef struct Replay {
+    uint8_t* trace;
+    size_t trace_len;
+    const uint8_t* request;
+    uint32_t request_len;
+    uint8_t* creds;
+    uint32_t creds_len;
+    CallingAppInfo calling_app_info;
+    size_t next_call; // Offset of the next record to compare emitted calls against
+    int calls_matched;
+    int calls_mismatched;
+    int unrecorded_reads;
+    struct timespec start;
+} Replay;
+
+static Replay* replay = NULL;
+
+static int IsEmittedCall(uint8_t tag) {
+    return tag == TRACE_STRING_ID_ENTRY || tag == TRACE_FIELD || tag == TRACE_PAYMENT_ENTRY || tag == TRACE_VERIFICATION_DISCLAIMER;
+}
+
+static void GrowReplayCreds(uint32_t len) {
+    if (len > replay->creds_len) {
+        replay->creds = realloc(replay->creds, len);
+        memset(replay->creds + replay->creds_len, 0, len - replay->creds_len);
+        replay->creds_len = len;
+    }
+}
+
+static uint8_t* ReadWholeFile(const char* path, size_t* len) {
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t* data = malloc(*len + 1);
+    *len = fread(data, 1, *len, f);
+    data[*len] = '\0';
+    fclose(f);
+    return data;
+}
+
+// Accepts the binary trace or a log line holding the base64url trace printed by the capture side.
+static uint8_t* LoadTrace(const char* path, size_t* len) {
+    uint8_t* data = ReadWholeFile(path, len);
+    if (data == NULL || TraceCheckHeader(data, *len)) {
+        return data;
+    }
+    char* encoded = strstr((char*)data, "CREDMAN_TRACE ");
+    if (encoded == NULL) {
+        free(data);
+        return NULL;
+    }
+    encoded += strlen("CREDMAN_TRACE ");
+    encoded[strcspn(encoded, "\r\n ")] = '\0';
+    char* decoded;
+    *len = B64DecodeURL(encoded, &decoded);
+    free(data);
+    return (uint8_t*)decoded;
+}
+
+static void ReportReplay(void) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed_ms = (end.tv_sec - replay->start.tv_sec) * 1e3 + (end.tv_nsec - replay->start.tv_nsec) / 1e6;
+    int calls_missing = 0;
+    TraceRecord record;
+    while (TraceNextRecord(replay->trace, replay->trace_len, &replay->next_call, &record)) {
+        calls_missing += IsEmittedCall(record.tag);
+    }
+    fprintf(stderr, "replay: %d calls matched, %d mismatched, %d missing, %d unrecorded reads, %.3f ms\n",
+            replay->calls_matched, replay->calls_mismatched, calls_missing, replay->unrecorded_reads, elapsed_ms);
+}
+
+__attribute__((constructor)) static void LoadReplay(void) {
+    const char* path = getenv("CREDMAN_REPLAY_PATH");
+    if (path == NULL) {
+        return;
+    }
+    replay = calloc(1, sizeof(Replay));
+    replay->trace = LoadTrace(path, &replay->trace_len);
+    if (replay->trace == NULL || !TraceCheckHeader(replay->trace, replay->trace_len)) {
+        fprintf(stderr, "replay: %s is not a credman trace\n", path);
+        exit(1);
+    }
+    size_t offset = 0;
+    TraceRecord record;
+    while (TraceNextRecord(replay->trace, replay->trace_len, &offset, &record)) {
+        uint32_t len;
+        const uint8_t* bytes;
+        switch (record.tag) {
+            case TRACE_REQUEST:
+                replay->request = TraceGetBytes(&record, &replay->request_len);
+                break;
+            case TRACE_CREDENTIALS_SIZE:
+                GrowReplayCreds(TraceGetU32(&record));
+                break;
+            case TRACE_CREDENTIALS_READ: {
+                uint32_t read_offset = TraceGetU32(&record);
+                TraceGetU32(&record); // Requested length
+                bytes = TraceGetBytes(&record, &len);
+                GrowReplayCreds(read_offset + len);
+                memcpy(replay->creds + read_offset, bytes, len);
+                break;
+            }
+            case TRACE_CALLING_APP_INFO:
+                bytes = TraceGetBytes(&record, &len);
+                memcpy(replay->calling_app_info.package_name, bytes, len < 255 ? len : 255);
+                bytes = TraceGetBytes(&record, &len);
+                memcpy(replay->calling_app_info.origin, bytes, len < 511 ? len : 511);
+                break;
+        }
+    }
+    atexit(ReportReplay);
+    clock_gettime(CLOCK_MONOTONIC, &replay->start);
+}
+
+// Compares an emitted call, encoded in call, with the next call recorded in the trace.
+static void CheckReplayCall(TraceBuffer* call) {
+    if (replay == NULL) {
+        free(call->data);
+        return;
+    }
+    TraceRecord record;
+    size_t start;
+    do {
+        start = replay->next_call < 8 ? 8 : replay->next_call;
+    } while (TraceNextRecord(replay->trace, replay->trace_len, &replay->next_call, &record) && !IsEmittedCall(record.tag));
+    size_t recorded_len = replay->next_call - start;
+    if (recorded_len == call->len && memcmp(replay->trace + start, call->data, call->len) == 0) {
+        replay->calls_matched++;
+    } else {
+        replay->calls_mismatched++;
+    }
+    free(call->data);
 }
 
 void GetRequestSize(uint32_t* size) {
-    GetFileSize(REQUEST_PATH, size);
+    HostCall();
+    if (replay != NULL) {
+        *size = replay->request_len;
+        return;
+    }
+    *size = RequestFile()->len;
 }
 
 void GetRequestBuffer(void* buffer) {
-    uint32_t len;
-    GetRequestSize(&len);
-    FILE* f = fopen(REQUEST_PATH, "r");
-    fread(buffer, len, 1, f);
-    fclose(f);
+    HostCall();
+    if (replay != NULL) {
+        memcpy(buffer, replay->request, replay->request_len);
+        return;
+    }
+    memcpy(buffer, RequestFile()->data, RequestFile()->len);
 }
 
 void GetCredentialsSize(uint32_t* size) {
-    GetFileSize(CREDS_PATH, size);
+    HostCall();
+    if (replay != NULL) {
+        *size = replay->creds_len;
+        return;
+    }
+    *size = CredsFile()->len;
 }
 
 size_t ReadCredentialsBuffer(void* buffer, size_t offset, size_t len) {
-    FILE* f = fopen(CREDS_PATH, "r");
-    fseek(f, offset, SEEK_SET);
-    size_t bytes_read = fread(buffer, 1, len, f);
-    fclose(f);
+    HostCall();
+    host_stats.credential_reads++;
+    if (replay != NULL) {
+        if (offset >= replay->creds_len) {
+            replay->unrecorded_reads++;
+            return 0;
+        }
+        size_t bytes_read = offset + len > replay->creds_len ? replay->creds_len - offset : len;
+        memcpy(buffer, replay->creds + offset, bytes_read);
+        host_stats.credential_bytes += bytes_read;
+        return bytes_read;
+    }
+    const MappedFile* creds = CredsFile();
+    if (offset >= creds->len) {
+        return 0;
+    }
+    size_t bytes_read = offset + len > creds->len ? creds->len - offset : len;
+    memcpy(buffer, creds->data + offset, bytes_read);
+    host_stats.credential_bytes += bytes_read;
     return bytes_read;
 }
 
+void GetCallingAppInfo(CallingAppInfo* info) {
+    HostCall();
+    if (replay != NULL) {
+        *info = replay->calling_app_info;
+        return;
+    }
+    memset(info, 0, sizeof(CallingAppInfo));
+    strncpy(info->package_name, GetEnvOr("CREDMAN_CALLING_PACKAGE", "com.credman.testharness"), sizeof(info->package_name) - 1);
+    strncpy(info->origin, GetEnvOr("CREDMAN_CALLING_ORIGIN", ""), sizeof(info->origin) - 1);
+}
+
 void AddStringIdEntry(char *cred_id, char* icon, size_t icon_len, char *title, char *subtitle, char *disclaimer, char *warning) {
-    printf("AddStringIdEntry id:%s title:%s subtitle:%s\n", cred_id, title, subtitle);
+    HostCall();
+    TraceBuffer call = {0};
+    TraceStringIdEntry(&call, cred_id, icon, icon_len, title, subtitle, disclaimer, warning);
+    CheckReplayCall(&call);
+    fputs("AddStringIdEntry", CallsFile());
+    PrintField(cred_id);
+    PrintIcon(icon, icon_len);
+    PrintField(title);
+    PrintField(subtitle);
+    PrintField(disclaimer);
+    PrintField(warning);
+    EndRecord();
 }
 
 void AddFieldForStringIdEntry(char *cred_id, char *field_display_name, char *field_display_value) {
-    printf("AddFieldForStringIdEntry id:%s field_display_name:%s\n", cred_id, field_display_name);
+    HostCall();
+    TraceBuffer call = {0};
+    TraceField(&call, cred_id, field_display_name, field_display_value);
+    CheckReplayCall(&call);
+    fputs("AddFieldForStringIdEntry", CallsFile());
+    PrintField(cred_id);
+    PrintField(field_display_name);
+    PrintField(field_display_value);
+    EndRecord();
+}
+
+void AddPaymentEntry(char *cred_id, char *merchant_name, char *payment_method_name, char *payment_method_subtitle, char* payment_method_icon, size_t payment_method_icon_len, char *transaction_amount, char* bank_icon, size_t bank_icon_len, char* payment_provider_icon, size_t payment_provider_icon_len) {
+    HostCall();
+    TraceBuffer call = {0};
+    TracePaymentEntry(&call, cred_id, merchant_name, payment_method_name, payment_method_subtitle, payment_method_icon, payment_method_icon_len, transaction_amount, bank_icon, bank_icon_len, payment_provider_icon, payment_provider_icon_len);
+    CheckReplayCall(&call);
+    fputs("AddPaymentEntry", CallsFile());
+    PrintField(cred_id);
+    PrintField(merchant_name);
+    PrintField(payment_method_name);
+    PrintField(payment_method_subtitle);
+    PrintIcon(payment_method_icon, payment_method_icon_len);
+    PrintField(transaction_amount);
+    PrintIcon(bank_icon, bank_icon_len);
+    PrintIcon(payment_provider_icon, payment_provider_icon_len);
+    EndRecord();
+}
+
+void SetAdditionalDisclaimerAndUrlForVerificationEntry(char *cred_id, char *secondary_disclaimer, char *url_display_text, char *url_value) {
+    HostCall();
+    TraceBuffer call = {0};
+    TraceVerificationDisclaimer(&call, cred_id, secondary_disclaimer, url_display_text, url_value);
+    CheckReplayCall(&call);
+    fputs("SetAdditionalDisclaimerAndUrlForVerificationEntry", CallsFile());
+    PrintField(cred_id);
+    PrintField(secondary_disclaimer);
+    PrintField(url_display_text);
+    PrintField(url_value);
+    EndRecord();
+}
+
+// Batches are decoded into the per-entry calls above, so the output is the same whether or not
+// the matcher was built with -DCREDMAN_BATCH.
+int32_t AddEntriesBatch(const void* buffer, size_t len) {
+    HostCall();
+    if (getenv("CREDMAN_NO_BATCH") != NULL) {
+        return 0;
+    }
+    in_batch = 1;
+    int emitted = BatchEmit(buffer, len);
+    in_batch = 0;
+    if (!emitted) {
+        fputs("AddEntriesBatch\tmalformed", CallsFile());
+        EndRecord();
+    }
+    return 1;
 }
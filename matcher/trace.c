@@ -0,0 +1,168 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+static void TraceReserve(TraceBuffer* trace, size_t len) {
+    if (trace->len + len <= trace->cap) {
+        return;
+    }
+    size_t cap = trace->cap == 0 ? 4096 : trace->cap;
+    while (cap < trace->len + len) {
+        cap *= 2;
+    }
+    trace->data = realloc(trace->data, cap);
+    trace->cap = cap;
+}
+
+static void TracePutRaw(TraceBuffer* trace, const void* bytes, size_t len) {
+    TraceReserve(trace, len);
+    memcpy(trace->data + trace->len, bytes, len);
+    trace->len += len;
+}
+
+void TraceBegin(TraceBuffer* trace) {
+    trace->data = NULL;
+    trace->len = 0;
+    trace->cap = 0;
+    TracePutRaw(trace, TRACE_MAGIC, 4);
+    TracePutU32(trace, TRACE_VERSION);
+}
+
+size_t TraceBeginRecord(TraceBuffer* trace, uint8_t tag) {
+    TracePutRaw(trace, &tag, 1);
+    size_t record = trace->len;
+    TracePutU32(trace, 0); // Patched by TraceEndRecord
+    return record;
+}
+
+void TraceEndRecord(TraceBuffer* trace, size_t record) {
+    uint32_t len = trace->len - record - 4;
+    for (int i=0; i<4; i++) {
+        trace->data[record + i] = (len >> (8 * i)) & 0xff;
+    }
+}
+
+void TracePutU32(TraceBuffer* trace, uint32_t value) {
+    uint8_t bytes[4];
+    for (int i=0; i<4; i++) {
+        bytes[i] = (value >> (8 * i)) & 0xff;
+    }
+    TracePutRaw(trace, bytes, 4);
+}
+
+void TracePutBytes(TraceBuffer* trace, const void* bytes, size_t len) {
+    TracePutU32(trace, len);
+    TracePutRaw(trace, bytes, len);
+}
+
+void TracePutString(TraceBuffer* trace, const char* value) {
+    if (value == NULL) {
+        TracePutU32(trace, TRACE_NULL_STRING);
+    } else {
+        TracePutBytes(trace, value, strlen(value));
+    }
+}
+
+void TracePutIcon(TraceBuffer* trace, const char* icon, size_t icon_len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; icon != NULL && i < icon_len; i++) {
+        hash ^= (uint8_t)icon[i];
+        hash *= 16777619u;
+    }
+    TracePutU32(trace, icon_len);
+    TracePutU32(trace, hash);
+}
+
+void TraceStringIdEntry(TraceBuffer* trace, char *cred_id, char* icon, size_t icon_len, char *title, char *subtitle, char *disclaimer, char *warning) {
+    size_t record = TraceBeginRecord(trace, TRACE_STRING_ID_ENTRY);
+    TracePutString(trace, cred_id);
+    TracePutIcon(trace, icon, icon_len);
+    TracePutString(trace, title);
+    TracePutString(trace, subtitle);
+    TracePutString(trace, disclaimer);
+    TracePutString(trace, warning);
+    TraceEndRecord(trace, record);
+}
+
+void TraceField(TraceBuffer* trace, char *cred_id, char *field_display_name, char *field_display_value) {
+    size_t record = TraceBeginRecord(trace, TRACE_FIELD);
+    TracePutString(trace, cred_id);
+    TracePutString(trace, field_display_name);
+    TracePutString(trace, field_display_value);
+    TraceEndRecord(trace, record);
+}
+
+void TracePaymentEntry(TraceBuffer* trace, char *cred_id, char *merchant_name, char *payment_method_name, char *payment_method_subtitle, char* payment_method_icon, size_t payment_method_icon_len, char *transaction_amount, char* bank_icon, size_t bank_icon_len, char* payment_provider_icon, size_t payment_provider_icon_len) {
+    size_t record = TraceBeginRecord(trace, TRACE_PAYMENT_ENTRY);
+    TracePutString(trace, cred_id);
+    TracePutString(trace, merchant_name);
+    TracePutString(trace, payment_method_name);
+    TracePutString(trace, payment_method_subtitle);
+    TracePutIcon(trace, payment_method_icon, payment_method_icon_len);
+    TracePutString(trace, transaction_amount);
+    TracePutIcon(trace, bank_icon, bank_icon_len);
+    TracePutIcon(trace, payment_provider_icon, payment_provider_icon_len);
+    TraceEndRecord(trace, record);
+}
+
+void TraceVerificationDisclaimer(TraceBuffer* trace, char *cred_id, char *secondary_disclaimer, char *url_display_text, char *url_value) {
+    size_t record = TraceBeginRecord(trace, TRACE_VERIFICATION_DISCLAIMER);
+    TracePutString(trace, cred_id);
+    TracePutString(trace, secondary_disclaimer);
+    TracePutString(trace, url_display_text);
+    TracePutString(trace, url_value);
+    TraceEndRecord(trace, record);
+}
+
+static uint32_t ReadU32(const uint8_t* bytes) {
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+int TraceCheckHeader(const uint8_t* data, size_t len) {
+    return len >= 8 && memcmp(data, TRACE_MAGIC, 4) == 0 && ReadU32(data + 4) == TRACE_VERSION;
+}
+
+int TraceNextRecord(const uint8_t* data, size_t len, size_t* offset, TraceRecord* record) {
+    if (*offset < 8) {
+        *offset = 8;
+    }
+    if (*offset + 5 > len) {
+        return 0;
+    }
+    uint32_t payload_len = ReadU32(data + *offset + 1);
+    if (*offset + 5 + payload_len > len) {
+        return 0;
+    }
+    record->tag = data[*offset];
+    record->payload = data + *offset + 5;
+    record->len = payload_len;
+    record->pos = 0;
+    *offset += 5 + payload_len;
+    return 1;
+}
+
+uint32_t TraceGetU32(TraceRecord* record) {
+    if (record->pos + 4 > record->len) {
+        record->pos = record->len;
+        return 0;
+    }
+    uint32_t value = ReadU32(record->payload + record->pos);
+    record->pos += 4;
+    return value;
+}
+
+const uint8_t* TraceGetBytes(TraceRecord* record, uint32_t* len) {
+    *len = TraceGetU32(record);
+    if (*len == TRACE_NULL_STRING) {
+        *len = 0;
+        return NULL;
+    }
+    if (record->pos + *len > record->len) {
+        *len = 0;
+        return NULL;
+    }
+    const uint8_t* bytes = record->payload + record->pos;
+    record->pos += *len;
+    return bytes;
+}
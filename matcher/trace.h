@@ -0,0 +1,70 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Trace of the host calls made by one matcher run, see credentialmanager.c for the capture side
+// and testharness.c for the replay side.
+//
+// |---------------------------------------|
+// |------ "CMTR", (u32) version ----------|
+// |-- (u8) tag, (u32) payload length -----|
+// |------------- payload -----------------|
+// |------------ More records... ----------|
+// |---------------------------------------|
+//
+// All integers are little endian. Strings and byte ranges are a u32 length followed by the bytes,
+// a NULL string has the length 0xffffffff. Icons are recorded as their length and FNV-1a digest.
+
+#define TRACE_MAGIC "CMTR"
+#define TRACE_VERSION 1
+#define TRACE_NULL_STRING 0xffffffffu
+
+enum TraceTag {
+    TRACE_REQUEST = 1,              // bytes returned by GetRequestBuffer
+    TRACE_CREDENTIALS_SIZE = 2,     // u32 returned by GetCredentialsSize
+    TRACE_CREDENTIALS_READ = 3,     // u32 offset, u32 requested length, bytes returned
+    TRACE_CALLING_APP_INFO = 4,     // package name, origin
+    TRACE_STRING_ID_ENTRY = 5,      // AddStringIdEntry arguments
+    TRACE_FIELD = 6,                // AddFieldForStringIdEntry arguments
+    TRACE_PAYMENT_ENTRY = 7,        // AddPaymentEntry arguments
+    TRACE_VERIFICATION_DISCLAIMER = 8 // SetAdditionalDisclaimerAndUrlForVerificationEntry arguments
+};
+
+typedef struct TraceBuffer {
+    uint8_t* data;
+    size_t len;
+    size_t cap;
+} TraceBuffer;
+
+void TraceBegin(TraceBuffer* trace);
+size_t TraceBeginRecord(TraceBuffer* trace, uint8_t tag);
+void TraceEndRecord(TraceBuffer* trace, size_t record);
+void TracePutU32(TraceBuffer* trace, uint32_t value);
+void TracePutBytes(TraceBuffer* trace, const void* bytes, size_t len);
+void TracePutString(TraceBuffer* trace, const char* value);
+void TracePutIcon(TraceBuffer* trace, const char* icon, size_t icon_len);
+
+// Encoders for the emitted calls. Capture and replay share them so that both sides produce the
+// same bytes for the same call.
+void TraceStringIdEntry(TraceBuffer* trace, char *cred_id, char* icon, size_t icon_len, char *title, char *subtitle, char *disclaimer, char *warning);
+void TraceField(TraceBuffer* trace, char *cred_id, char *field_display_name, char *field_display_value);
+void TracePaymentEntry(TraceBuffer* trace, char *cred_id, char *merchant_name, char *payment_method_name, char *payment_method_subtitle, char* payment_method_icon, size_t payment_method_icon_len, char *transaction_amount, char* bank_icon, size_t bank_icon_len, char* payment_provider_icon, size_t payment_provider_icon_len);
+void TraceVerificationDisclaimer(TraceBuffer* trace, char *cred_id, char *secondary_disclaimer, char *url_display_text, char *url_value);
+
+typedef struct TraceRecord {
+    uint8_t tag;
+    const uint8_t* payload;
+    uint32_t len;
+    uint32_t pos; // read position within the payload
+} TraceRecord;
+
+// Returns 0 when data does not start with a supported trace header.
+int TraceCheckHeader(const uint8_t* data, size_t len);
+// Iterates over the records following the header. Returns 0 at the end of the trace.
+int TraceNextRecord(const uint8_t* data, size_t len, size_t* offset, TraceRecord* record);
+uint32_t TraceGetU32(TraceRecord* record);
+const uint8_t* TraceGetBytes(TraceRecord* record, uint32_t* len);
+
+#endif
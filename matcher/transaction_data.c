@@ -0,0 +1,84 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "base64.h"
+#include "hash.h"
+#include "transaction_data.h"
+
+static cJSON* DecodeItem(cJSON* encoded) {
+    char* encoded_str = cJSON_GetStringValue(encoded);
+    if (encoded_str == NULL) {
+        return NULL;
+    }
+    char* json;
+    int json_len = B64DecodeURL(encoded_str, &json);
+    return cJSON_ParseWithLength(json, json_len);
+}
+
+static void Insert(TransactionData* table, const char* credential_id, cJSON* item) {
+    uint32_t hash = HashString(credential_id);
+    uint32_t slot = hash & table->mask;
+    while (table->slots[slot].credential_id != NULL) {
+        if (table->slots[slot].hash == hash && strcmp(table->slots[slot].credential_id, credential_id) == 0) {
+            return; // The first item listing a credential query wins
+        }
+        slot = (slot + 1) & table->mask;
+    }
+    table->slots[slot].credential_id = credential_id;
+    table->slots[slot].hash = hash;
+    table->slots[slot].merchant_name = cJSON_GetStringValue(cJSON_GetObjectItem(item, "merchant_name"));
+    table->slots[slot].amount = cJSON_GetStringValue(cJSON_GetObjectItem(item, "amount"));
+    table->count++;
+}
+
+void ParseTransactionData(cJSON* transaction_data_list, TransactionData* table) {
+    memset(table, 0, sizeof(TransactionData));
+    int items_size = cJSON_GetArraySize(transaction_data_list);
+    if (items_size <= 0) {
+        return;
+    }
+    table->items_count = items_size;
+
+    cJSON** items = malloc(sizeof(cJSON*) * items_size);
+    int ids_size = 0;
+    for (int i=0; i<items_size; i++) {
+        items[i] = DecodeItem(cJSON_GetArrayItem(transaction_data_list, i));
+        ids_size += cJSON_GetArraySize(cJSON_GetObjectItem(items[i], "credential_ids"));
+    }
+    if (items[0] != NULL) {
+        table->merchant_name = cJSON_GetStringValue(cJSON_GetObjectItem(items[0], "merchant_name"));
+        table->amount = cJSON_GetStringValue(cJSON_GetObjectItem(items[0], "amount"));
+    }
+
+    // At most half full
+    uint32_t capacity = 4;
+    while (capacity < 2 * (uint32_t)ids_size) {
+        capacity *= 2;
+    }
+    table->slots = calloc(capacity, sizeof(TransactionItem));
+    table->mask = capacity - 1;
+    for (int i=0; i<items_size; i++) {
+        cJSON* credential_id;
+        cJSON_ArrayForEach(credential_id, cJSON_GetObjectItem(items[i], "credential_ids")) {
+            if (cJSON_IsString(credential_id)) {
+                Insert(table, cJSON_GetStringValue(credential_id), items[i]);
+            }
+        }
+    }
+    free(items);
+}
+
+const TransactionItem* FindTransactionItem(const TransactionData* table, const char* credential_id) {
+    if (table->count == 0 || credential_id == NULL) {
+        return NULL;
+    }
+    uint32_t hash = HashString(credential_id);
+    uint32_t slot = hash & table->mask;
+    while (table->slots[slot].credential_id != NULL) {
+        if (table->slots[slot].hash == hash && strcmp(table->slots[slot].credential_id, credential_id) == 0) {
+            return &table->slots[slot];
+        }
+        slot = (slot + 1) & table->mask;
+    }
+    return NULL;
+}
@@ -0,0 +1,34 @@
+#ifndef TRANSACTION_DATA_H
+#define TRANSACTION_DATA_H
+
+#include <stdint.h>
+
+#include "cJSON/cJSON.h"
+
+// The transaction_data items of one request, decoded once and indexed by the credential query ids
+// listed in their "credential_ids".
+typedef struct TransactionItem {
+    const char* credential_id;
+    uint32_t hash;
+    char* merchant_name;
+    char* amount;
+} TransactionItem;
+
+typedef struct TransactionData {
+    TransactionItem* slots; // open addressing, credential_id is NULL for empty slots
+    uint32_t mask;
+    int count;
+    int items_count;
+    // Of the first item, for the issuance offer made when nothing matched.
+    char* merchant_name;
+    char* amount;
+} TransactionData;
+
+// Decodes every base64url item of transaction_data_list into table. An empty table (count 0)
+// means the request has no transaction data that applies to a credential query.
+void ParseTransactionData(cJSON* transaction_data_list, TransactionData* table);
+
+// Returns the first item that applies to the credential query credential_id, or NULL.
+const TransactionItem* FindTransactionItem(const TransactionData* table, const char* credential_id);
+
+#endif